@@ -0,0 +1,145 @@
+#ifndef _MENCI_HTML_PARSER_ATOMS_H
+#define _MENCI_HTML_PARSER_ATOMS_H
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+#include "Elements.h"
+
+namespace html_parser {
+	// A known tag or attribute name interned as a small integer, so that it's compared and
+	// classified without looking at its characters. Any other name is the unknownAtom and
+	// has to be compared as a string.
+	using Atom = uint16_t;
+
+	inline constexpr Atom unknownAtom = 0;
+
+	// The known names, lowered and indexed by their atoms. The HTML tags and attributes
+	// from https://developer.mozilla.org/en-US/docs/Web/HTML.
+	inline constexpr std::string_view atomNames[] = {
+		"",
+		"a", "abbr", "accept", "accept-charset", "accesskey", "acronym", "action",
+		"address", "align", "allow", "alt", "applet", "area", "article", "aside", "async",
+		"audio", "autocomplete", "autofocus", "autoplay",
+		"b", "background", "base", "basefont", "bdi", "bdo", "bgcolor", "big",
+		"blockquote", "body", "border", "br", "button",
+		"canvas", "caption", "center", "charset", "checked", "cite", "class", "code",
+		"col", "colgroup", "color", "cols", "colspan", "command", "content",
+		"contenteditable", "controls", "coords", "crossorigin",
+		"data", "datalist", "datetime", "dd", "decoding", "default", "defer", "del",
+		"details", "dfn", "dialog", "dir", "dirname", "disabled", "div", "dl", "download",
+		"draggable", "dt",
+		"em", "embed", "enctype",
+		"fieldset", "figcaption", "figure", "font", "footer", "for", "form", "formaction",
+		"frame", "frameset",
+		"h1", "h2", "h3", "h4", "h5", "h6", "head", "header", "headers", "height",
+		"hgroup", "hidden", "high", "hr", "href", "hreflang", "html", "http-equiv",
+		"i", "id", "iframe", "image", "img", "input", "inputmode", "ins", "integrity",
+		"isindex", "ismap", "itemprop", "itemscope", "itemtype",
+		"kbd", "keygen", "kind",
+		"label", "lang", "language", "legend", "li", "link", "list", "listing", "loading",
+		"loop", "low",
+		"main", "map", "mark", "marquee", "math", "max", "maxlength", "media", "menu",
+		"meta", "meter", "method", "min", "minlength", "multiple", "muted",
+		"name", "nav", "nobr", "noframes", "nonce", "noscript", "novalidate",
+		"object", "ol", "onclick", "onload", "open", "optgroup", "optimum", "option",
+		"output",
+		"p", "param", "pattern", "picture", "placeholder", "plaintext", "poster", "pre",
+		"preload", "progress", "property",
+		"q",
+		"readonly", "referrerpolicy", "rel", "required", "reversed", "role", "rows",
+		"rowspan", "rp", "rt", "ruby",
+		"s", "samp", "sandbox", "scope", "script", "search", "section", "select",
+		"selected", "shape", "size", "sizes", "slot", "small", "source", "span",
+		"spellcheck", "src", "srcdoc", "srclang", "srcset", "start", "step", "strike",
+		"strong", "style", "sub", "summary", "sup", "svg",
+		"tabindex", "table", "target", "tbody", "td", "template", "textarea", "tfoot",
+		"th", "thead", "time", "title", "tr", "track", "translate", "tt", "type",
+		"u", "ul", "usemap",
+		"value", "var", "video",
+		"wbr", "width", "wrap",
+		"xmp", };
+
+	inline constexpr size_t atomCount = std::size(atomNames);
+
+	// Atoms are looked up in a table by a perfect hash of the name: FNV-1a, starting from a
+	// seed that's been searched to give every known name a slot of its own. This is checked
+	// at compile time, so pick another seed if a new name is added and the check fails.
+	inline constexpr uint32_t atomHashSeed = 8249;
+	inline constexpr size_t atomTableBits = 12;
+
+	constexpr size_t getAtomSlot(std::string_view name)
+	{
+		uint32_t hash = atomHashSeed;
+		for (char ch : name)
+		{
+			hash ^= (unsigned char)ch;
+			hash *= 16777619u;
+		}
+
+		return hash >> (32 - atomTableBits);
+	}
+
+	constexpr std::array<Atom, (size_t)1 << atomTableBits> buildAtomTable()
+	{
+		std::array<Atom, (size_t)1 << atomTableBits> table{};
+		for (Atom atom = 1; atom < atomCount; atom++)
+		{
+			table[getAtomSlot(atomNames[atom])] = atom;
+		}
+
+		return table;
+	}
+
+	inline constexpr auto atomTable = buildAtomTable();
+
+	// Return the atom of a name, or unknownAtom. The name is matched as-is, so tag and
+	// attribute names have to be lowered first.
+	constexpr Atom findAtom(std::string_view name)
+	{
+		Atom atom = atomTable[getAtomSlot(name)];
+		return atomNames[atom] == name ? atom : unknownAtom;
+	}
+
+	constexpr bool isAtomHashPerfect()
+	{
+		for (Atom atom = 1; atom < atomCount; atom++)
+		{
+			if (findAtom(atomNames[atom]) != atom) return false;
+		}
+
+		return true;
+	}
+
+	static_assert(isAtomHashPerfect(), "Two known names share a slot, change the atomHashSeed");
+
+	// What a element is known to be, as bits of its tag's atom.
+	enum ElementKind : unsigned char
+	{
+		EmptyElement = 1,
+		RawTextElement = 2,
+		EscapableRawTextElement = 4
+	};
+
+	constexpr std::array<unsigned char, atomCount> buildElementKinds()
+	{
+		std::array<unsigned char, atomCount> kinds{};
+		for (std::string_view name : emptyElements) kinds[findAtom(name)] |= EmptyElement;
+		for (std::string_view name : rawTextElements) kinds[findAtom(name)] |= RawTextElement;
+		for (std::string_view name : escapableRawTextElements) kinds[findAtom(name)] |= EscapableRawTextElement;
+		return kinds;
+	}
+
+	inline constexpr auto elementKinds = buildElementKinds();
+
+	static_assert(elementKinds[unknownAtom] == 0, "Every element in Elements.h must have an atom");
+
+	constexpr bool isElementOfKind(Atom tag, ElementKind kind)
+	{
+		return elementKinds[tag] & kind;
+	}
+}
+
+#endif // _MENCI_HTML_PARSER_ATOMS_H
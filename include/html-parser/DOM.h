@@ -1,63 +1,367 @@
 #ifndef _MENCI_HTML_PARSER_DOM_H
 #define _MENCI_HTML_PARSER_DOM_H
 
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <type_traits>
 #include <unordered_set>
 #include <vector>
 #include <memory>
+#include <memory_resource>
 
 #include <string>
+#include <string_view>
+
+#include "macros.h"
+
+#include "Atoms.h"
+#include "HTMLEntities.h"
 
 namespace html_parser {
     namespace DOM
     {
 
+        // Nodes are allocated from the arena of the tree's root (see RootNode) and never
+        // destroyed one by one, so everything in them is allocated from the arena too. Their
+        // strings are views into it, copied there by RootNode::store().
+
         struct Node
         {
+            // Checked to tell the type of a node, before a static_cast to it.
+            enum class Type : unsigned char
+            {
+                Root,
+                Element,
+                Text,
+                Comment
+            };
+
             struct NodeWithChildren* parentNode;
+            const Type type;
 
-            Node(struct NodeWithChildren* parentNode) : parentNode(parentNode) {}
+            // There's no virtual destructor: the nodes in a tree are never destroyed, and a root
+            // is destroyed by the shared_ptr it's made with, which knows its type.
+            Node(Type type, struct NodeWithChildren* parentNode) : parentNode(parentNode), type(type) {}
 
-            // A class without virtual table can't be dymanic_cast-ed.
-            virtual ~Node() {}
+            // Whether it's a NodeWithChildren.
+            bool hasChildren() const
+            {
+                return type == Type::Root || type == Type::Element;
+            }
         };
 
         struct NodeWithChildren : Node
         {
-            NodeWithChildren(NodeWithChildren* parentNode) : Node(parentNode) {}
+            NodeWithChildren(Type type, NodeWithChildren* parentNode, std::pmr::memory_resource* memory) : Node(type, parentNode), children(memory) {}
 
-            std::vector<std::shared_ptr<Node>> children;
+            // Owned by the arena, not by the parent.
+            std::pmr::vector<Node*> children;
         };
 
+        // The root of a tree, owning the memory of every node in it. The nodes are allocated
+        // from a arena on top of the given memory resource, which gets it back in a few big
+        // blocks when the root is destroyed.
         struct RootNode : NodeWithChildren
         {
-            RootNode() : NodeWithChildren(nullptr) {}
+            explicit RootNode(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+                : NodeWithChildren(Type::Root, nullptr, upstream), arena(upstream), internedStrings(upstream) {}
+
+            RootNode(const RootNode&) = delete;
+            RootNode& operator=(const RootNode&) = delete;
+
+            // Create a node in the arena, to be added to the tree. A node with containers is
+            // given the arena to allocate them from.
+            template <typename T, typename... Args>
+            T* create(NodeWithChildren* parentNode, Args&&... args)
+            {
+                void* memory = arena.allocate(sizeof(T), alignof(T));
+                if constexpr (std::is_constructible_v<T, NodeWithChildren*, Args..., std::pmr::memory_resource*>)
+                {
+                    return new (memory) T(parentNode, std::forward<Args>(args)..., &arena);
+                }
+                else
+                {
+                    return new (memory) T(parentNode, std::forward<Args>(args)...);
+                }
+            }
+
+            // Copy a string to the arena, to live as long as the tree. The strings are packed
+            // one after another in the arena's blocks, instead of allocated one by one.
+            std::string_view store(std::string_view string)
+            {
+                if (string.empty())
+                {
+                    return std::string_view();
+                }
+
+                char* data = static_cast<char*>(arena.allocate(string.length(), 1));
+                std::memcpy(data, string.data(), string.length());
+                return std::string_view(data, string.length());
+            }
+
+            // Like store(), but the copy is lowered.
+            std::string_view storeLowered(std::string_view string)
+            {
+                std::string_view stored = store(string);
+                char* data = const_cast<char*>(stored.data());
+                std::transform(data, data + stored.length(), data, toLowerAscii);
+                return stored;
+            }
+
+            // Store a string stored before followed by another. If it's the last one stored, it's
+            // extended in place while the arena's block has room, so a text stored piece by piece
+            // is copied again only when a new block is needed.
+            std::string_view storeAppended(std::string_view stored, std::string_view string)
+            {
+                if (string.empty())
+                {
+                    return stored;
+                }
+
+                char* data = static_cast<char*>(arena.allocate(string.length(), 1));
+                if (!stored.empty() && data == stored.data() + stored.length())
+                {
+                    std::memcpy(data, string.data(), string.length());
+                    return std::string_view(stored.data(), stored.length() + string.length());
+                }
+
+                data = static_cast<char*>(arena.allocate(stored.length() + string.length(), 1));
+                std::memcpy(data, stored.data(), stored.length());
+                std::memcpy(data + stored.length(), string.data(), string.length());
+                return std::string_view(data, stored.length() + string.length());
+            }
+
+            // Like store(), but a string equal to one interned before isn't copied again -- the
+            // same view is returned, so interned strings can be compared by their data.
+            std::string_view intern(std::string_view string)
+            {
+                auto it = internedStrings.find(string);
+                if (it != internedStrings.end())
+                {
+                    return *it;
+                }
+
+                std::string_view stored = store(string);
+                internedStrings.insert(stored);
+                return stored;
+            }
+
+            // The attributes kept, if not all (see ParseOptions), when lazy ones are parsed.
+            std::optional<std::vector<std::string>> attributeAllowlist;
+
+            // Keep another tree alive with this one, once its nodes are moved here.
+            void adopt(std::shared_ptr<RootNode> tree)
+            {
+                adoptedTrees.push_back(std::move(tree));
+            }
+
+        private:
+            friend struct ElementNode;
+
+            std::pmr::monotonic_buffer_resource arena;
+            std::vector<std::shared_ptr<RootNode>> adoptedTrees;
+
+            // Views into the arena. The table itself is freed with the root.
+            std::pmr::unordered_set<std::string_view> internedStrings;
+
+            // Held while a element's lazy attributes are parsed into the arena.
+            std::mutex lazyAttributesMutex;
+        };
+
+        // A attribute of a element, by its lowered name.
+        struct Attribute
+        {
+            std::string_view name, value;
         };
 
         struct ElementNode : NodeWithChildren
         {
-            ElementNode(NodeWithChildren* parentNode) : NodeWithChildren(parentNode) {}
+            ElementNode(NodeWithChildren* parentNode, std::pmr::memory_resource* memory)
+                : NodeWithChildren(Type::Element, parentNode, memory), attributes(memory), classList(memory), idList(memory) {}
+
+            std::string_view tagName;
+            Atom tagAtom = unknownAtom; // The atom of the lowered tagName.
+
+            // Most elements have only a few attributes and classes, so they're kept in small
+            // arrays instead of hash tables and looked up linearly. The attributes are in the
+            // order they're set, the class and id lists are sorted without duplicates.
+            //
+            // If the attributes are lazy (see ParseOptions), they're parsed from the text of
+            // the tag only when one of them is first read, so read them by the getters below.
+            std::pmr::vector<Attribute> attributes;
+            std::pmr::vector<std::string_view> classList;
+            std::pmr::vector<std::string_view> idList;
+
+            // The tag's text, stored in the tree, while the attributes are not parsed yet, and
+            // the root of the tree it's stored in, whose arena the attributes are parsed into.
+            std::string_view unparsedTag;
+            RootNode* unparsedTagRoot = nullptr;
+            std::atomic<bool> attributesParsed{ true };
+
+            const std::pmr::vector<Attribute>& getAttributes() const
+            {
+                parseLazyAttributes();
+                return attributes;
+            }
+
+            const std::pmr::vector<std::string_view>& getClassList() const
+            {
+                parseLazyAttributes();
+                return classList;
+            }
+
+            const std::pmr::vector<std::string_view>& getIdList() const
+            {
+                parseLazyAttributes();
+                return idList;
+            }
+
+            // Parse the attributes if they're lazy and not parsed yet. It's safe to read a
+            // tree on many threads at once: only one element of a tree is parsed at a time.
+            void parseLazyAttributes() const
+            {
+                if (!attributesParsed.load(std::memory_order_acquire))
+                {
+                    const_cast<ElementNode*>(this)->parseUnparsedTag();
+                }
+            }
+
+            // Return the value of a attribute, or null if it's not set.
+            const std::string_view* findAttribute(std::string_view name) const
+            {
+                for (const Attribute& attribute : getAttributes())
+                {
+                    if (attribute.name == name)
+                    {
+                        return &attribute.value;
+                    }
+                }
+
+                return nullptr;
+            }
+
+            // Set a attribute, replacing the value if it's already set. The name and the value
+            // must be stored in the tree. Lazy attributes must be parsed first.
+            void setAttribute(std::string_view name, std::string_view value)
+            {
+                for (Attribute& attribute : attributes)
+                {
+                    if (attribute.name == name)
+                    {
+                        attribute.value = value;
+                        return;
+                    }
+                }
 
-            std::string tagName;
-            std::unordered_map<std::string, std::string> attributes;
-            std::unordered_set<std::string> classList;
-            std::unordered_set<std::string> idList;
+                attributes.push_back(Attribute{ name, value });
+            }
+
+            // Check if a sorted class or id list contains a item.
+            static bool listContains(const std::pmr::vector<std::string_view>& list, std::string_view item)
+            {
+                auto it = std::lower_bound(list.begin(), list.end(), item);
+                return it != list.end() && *it == item;
+            }
+
+        private:
+            // Defined with the tag parsing, in DOMBuilder.cc.
+            void parseUnparsedTag();
         };
 
         struct TextNode : Node
         {
-            std::string content;
+            // As in the source. If needsDecoding, it has entities, which are decoded only when
+            // the text is read by appendText() or getText().
+            std::string_view content;
+            bool needsDecoding;
+
+            TextNode(NodeWithChildren* parentNode, std::string_view content, bool needsDecoding)
+                : Node(Type::Text, parentNode), content(content), needsDecoding(needsDecoding) {}
 
-            TextNode(NodeWithChildren* parentNode, const std::string& content) : Node(parentNode), content(content) {}
+            // Append the text, with its entities decoded, to result.
+            void appendText(std::string& result) const
+            {
+                if (needsDecoding)
+                {
+                    decodeHTMLEntites(content, result);
+                }
+                else
+                {
+                    result += content;
+                }
+            }
+
+            std::string getText() const
+            {
+                std::string result;
+                appendText(result);
+                return result;
+            }
         };
 
         struct CommentNode : Node
         {
-            std::string content;
+            std::string_view content;
 
-            CommentNode(NodeWithChildren* parentNode, const std::string& content) : Node(parentNode), content(content) {}
+            CommentNode(NodeWithChildren* parentNode, std::string_view content) : Node(Type::Comment, parentNode), content(content) {}
         };
 
+        // Visit the nodes in the subtree of a node, but not the node, in document order. The
+        // visitor is called with each node and its depth below the node, 1 for a child, and
+        // returns false to stop. Return false if it's stopped.
+        //
+        // It's a loop over a stack of the children left to visit at each depth, instead of a
+        // recursion, so any depth of tree can be visited.
+        template <typename Visitor>
+        bool forEachInSubtree(const NodeWithChildren* node, Visitor&& visitor)
+        {
+            // The children left to visit of the nodes above, and of the current one.
+            struct Level
+            {
+                Node* const* next;
+                Node* const* end;
+            };
+
+            std::vector<Level> levels;
+            Node* const* next = node->children.data();
+            Node* const* end = next + node->children.size();
+            for (;;)
+            {
+                if (next == end)
+                {
+                    if (levels.empty())
+                    {
+                        return true;
+                    }
+
+                    next = levels.back().next;
+                    end = levels.back().end;
+                    levels.pop_back();
+                    continue;
+                }
+
+                Node* child = *next++;
+                if (!visitor(child, levels.size() + 1))
+                {
+                    return false;
+                }
+
+                if (child->hasChildren())
+                {
+                    const auto& children = static_cast<const NodeWithChildren*>(child)->children;
+                    if (!children.empty())
+                    {
+                        levels.push_back(Level{ next, end });
+                        next = children.data();
+                        end = next + children.size();
+                    }
+                }
+            }
+        }
+
     }
 }
 
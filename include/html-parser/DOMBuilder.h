@@ -1,14 +1,171 @@
 #ifndef _MENCI_HTML_PARSER_DOMBUILDER_H
 #define _MENCI_HTML_PARSER_DOMBUILDER_H
 
+#include <array>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include "macros.h"
 
 #include "Token.h"
+#include "Lexer.h"
 #include "DOM.h"
+#include "ParseOptions.h"
 
 namespace html_parser {
-	DOM::RootNode buildDOM(const std::vector<Token>& tokens);
+	// Builds a DOM tree from tokens, one token after another, so the tree grows while the
+	// document is being lexed.
+	class DOMBuilder
+	{
+		// A element not closed yet, which the nodes after its open tag are in.
+		struct OpenElement
+		{
+			enum class State : unsigned char
+			{
+				Selected, // Kept with its subtree -- every element is, without a filter.
+				Ancestor, // Kept as a ancestor of a selected element.
+				Skipped // Filtered out, not in the tree.
+			};
+
+			DOM::ElementNode* node; // Null if skipped.
+			DOM::NodeWithChildren* parent; // Where the nodes were added before it's opened.
+			Atom tagAtom;
+			State state;
+
+			// For a skipped element, its lowered name and the text of its open tag are kept in
+			// skippedTags, one after another from tagsStart.
+			size_t tagsStart, nameLength, tagLength;
+		};
+
+		// Where the nodes created are allocated.
+		DOM::RootNode* root;
+
+		// Where the nodes are added: the node of the innermost open element kept, or the root.
+		DOM::NodeWithChildren* currentNode;
+
+		ParseOptions options;
+		std::vector<OpenElement> openElements;
+		std::string skippedTags;
+
+		// How many of the open elements have each name, so a close tag matching none is
+		// ignored without searching them. A unknown name is counted by the name.
+		std::array<size_t, atomCount> openCounts{};
+		std::unordered_map<std::string, size_t> unknownOpenCounts;
+
+		// A unknown name is copied here to be looked up, and the name of a close tag lowered
+		// here, instead of to new strings.
+		std::string unknownTagName, closeTagName;
+
+		// The nodes created, but the root.
+		size_t nodeCount = 0;
+
+		template <typename T, typename... Args>
+		T* createNode(Args&&... args)
+		{
+			nodeCount++;
+			return root->create<T>(currentNode, std::forward<Args>(args)...);
+		}
+
+		bool appendToken(const Token& token, const TagParts* parts);
+		bool isSelecting() const;
+		bool isSelected(std::string_view tagName, const TagParts* parts, std::string_view attributesString) const;
+		void pushOpenElement(const OpenElement& element, std::string_view tagName);
+		void openElement(DOM::ElementNode* node);
+		void skipElement(std::string_view tagName, std::string_view tag);
+		void keepSkippedAncestors();
+		void closeElements(size_t depth);
+		std::string_view getTagName(const OpenElement& element) const;
+
+	public:
+		// The root must outlive the builder.
+		explicit DOMBuilder(DOM::RootNode& root, const ParseOptions& options = ParseOptions())
+			: root(&root), currentNode(&root), options(options)
+		{
+			root.attributeAllowlist = options.attributeAllowlist;
+		}
+
+		// Start building another tree, keeping the memory of the elements open.
+		void reset(DOM::RootNode& root);
+
+		// Return false if the token is a close tag matching no open element, which is
+		// ignored.
+		bool append(const Token& token);
+
+		// The same, with the parts of a tag token extracted by the lexer, instead of parsing
+		// its text again.
+		bool append(const Token& token, const TagParts& parts);
+
+		// Whether the current node is a raw text element, where everything but its close tag
+		// is text.
+		bool isInRawText() const;
+
+		size_t getNodeCount() const
+		{
+			return nodeCount;
+		}
+
+		// The elements open, including those filtered out.
+		size_t getDepth() const
+		{
+			return openElements.size();
+		}
+
+		// Move the tree built by another builder from an empty root here, as if its tokens
+		// were appended to this builder. That's only the same if this builder is not in raw
+		// text, and the other builder didn't ignore a close tag (which may close an element
+		// here). The other tree's arena is then kept alive by this builder's root.
+		void adopt(const std::shared_ptr<DOM::RootNode>& root, const DOMBuilder& builder);
+	};
+
+	// Checks the limits of a parse as the tokens are appended to a builder.
+	class ParseBudget
+	{
+		const ParseLimits& limits;
+
+		// Until the clock and the cancellation are checked again.
+		unsigned tokensUntilCheck = 0;
+
+	public:
+		explicit ParseBudget(const ParseLimits& limits) : limits(limits) {}
+
+		// Call before the first token and after each one. Return Complete while it's within
+		// the limits, or the limit passed -- the input size isn't checked here.
+		ParseStatus check(const DOMBuilder& builder);
+	};
+
+	// Append the tokens of html to a builder until one goes past a limit, and return why
+	// it stopped. The tree is then what the tokens before give, as if html ended there. The
+	// tags' parts are extracted into parts, so its storage can be reused across documents.
+	ParseStatus buildDOM(DOMBuilder& builder, std::string_view html, const ParseLimits& limits, TagParts& parts);
+
+	// The tree's nodes are allocated from a arena on top of memory.
+	std::shared_ptr<DOM::RootNode> buildDOM(const std::vector<Token>& tokens,
+		std::pmr::memory_resource* memory = std::pmr::get_default_resource(),
+		const ParseOptions& options = ParseOptions());
+
+	// Build the tree while pulling the tokens, without keeping them all. It's a single pass
+	// over the contents: the tags' names and attributes are extracted as they're lexed.
+	std::shared_ptr<DOM::RootNode> buildDOM(TokenStream tokens,
+		std::pmr::memory_resource* memory = std::pmr::get_default_resource(),
+		const ParseOptions& options = ParseOptions());
+
+	// Lex on another thread while building on this one, giving the same tree as buildDOM().
+	// The tokens are handed over in batches through a lock-free queue.
+	std::shared_ptr<DOM::RootNode> buildDOMPipelined(TokenStream tokens,
+		std::pmr::memory_resource* memory = std::pmr::get_default_resource(),
+		const ParseOptions& options = ParseOptions());
+
+	// Build on up to threadCount threads, giving the same tree as buildDOM(). The tokens are
+	// split into chunks, each built from an empty root guessing that the close tags it can't
+	// match close elements opened before it, and grafted in order onto the tree before. A
+	// chunk is built again from where a guess is wrong, or if it starts in raw text. A few
+	// tokens are built on this thread.
+	std::shared_ptr<DOM::RootNode> buildDOMParallel(const std::vector<Token>& tokens, unsigned threadCount,
+		std::pmr::memory_resource* memory = std::pmr::get_default_resource(),
+		const ParseOptions& options = ParseOptions());
 }
 
 #endif // _MENCI_HTML_PARSER_DOMBUILDER_H
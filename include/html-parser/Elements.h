@@ -0,0 +1,45 @@
+#ifndef _MENCI_HTML_PARSER_ELEMENTS_H
+#define _MENCI_HTML_PARSER_ELEMENTS_H
+
+#include <string_view>
+
+namespace html_parser {
+	// These elements' open tags don't need close tags and they don't have a subtree.
+	// From https://developer.mozilla.org/en-US/docs/Glossary/Empty_element.
+	inline constexpr std::string_view emptyElements[] = {
+		"area",
+		"base",
+		"br",
+		"col",
+		"colgroup",
+		"command",
+		"embed",
+		"hr",
+		"img",
+		"input",
+		"keygen",
+		"link",
+		"meta",
+		"param",
+		"source",
+		"track",
+		"wbr" };
+
+	// These elements don't contain any child elements. Everything inside them is
+	// just a TextNode.
+	// From https://www.w3.org/TR/html5/syntax.html#writing-html-documents-elements.
+	inline constexpr std::string_view rawTextElements[] = {
+		"script",
+		"style",
+		"textarea",
+		"title" };
+
+	// These raw text elements contain escaped string -- e.g. &nbsp; will be replaced
+	// with a space ' ' in these elements but not in other raw text elements.
+	// From https://www.w3.org/TR/html5/syntax.html#writing-html-documents-elements.
+	inline constexpr std::string_view escapableRawTextElements[] = {
+		"textarea",
+		"title" };
+}
+
+#endif // _MENCI_HTML_PARSER_ELEMENTS_H
@@ -0,0 +1,143 @@
+#ifndef _MENCI_HTML_PARSER_FLATDOCUMENT_H
+#define _MENCI_HTML_PARSER_FLATDOCUMENT_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "Atoms.h"
+#include "DOM.h"
+
+namespace html_parser {
+	// A read-only copy of a DOM tree, laid out flat for scraping. The nodes are numbered in
+	// document order and described by parallel arrays indexed by their numbers, with all
+	// strings in one buffer. A node's subtree is the nodes after it up to its subtree end, so
+	// it's searched by a linear scan over contiguous memory instead of chasing pointers.
+	//
+	// It doesn't refer to the tree it's copied from, which can be freed afterwards.
+	class FlatDocument
+	{
+	public:
+		using Index = uint32_t;
+
+		// No such node -- e.g. the parent of the root, or the next sibling of a last child.
+		static constexpr Index none = UINT32_MAX;
+
+		// The root node, which the others are in the subtree of.
+		static constexpr Index root = 0;
+
+	private:
+		// A string in the buffer.
+		struct Span
+		{
+			uint32_t start, length;
+		};
+
+		// A range of a node's entries in attributes, classes or ids.
+		struct Range
+		{
+			uint32_t start, count;
+		};
+
+		struct Attribute
+		{
+			Span name, value;
+		};
+
+		// Indexed by node.
+		std::vector<DOM::Node::Type> types;
+		std::vector<Atom> tagAtoms; // unknownAtom for a node other than a element.
+		std::vector<Index> parents, firstChildren, nextSiblings;
+		std::vector<Index> subtreeEnds; // One past the last node in the subtree.
+		std::vector<Span> texts; // The tag name of a element, or the content of a text or comment.
+		std::vector<Range> attributeRanges, classRanges, idRanges;
+
+		std::vector<Attribute> attributes;
+		std::vector<Span> classes, ids; // Sorted in each node's range, like the DOM's lists.
+
+		std::string strings;
+
+		Span addString(std::string_view string);
+		Range addList(const std::pmr::vector<std::string_view>& list, std::vector<Span>& spans);
+		Index addNode(const DOM::Node* node, Index parent);
+
+		std::string_view getString(Span span) const
+		{
+			return std::string_view(strings).substr(span.start, span.length);
+		}
+
+		bool listContains(const std::vector<Span>& spans, Range range, std::string_view item) const;
+		std::unordered_set<std::string> copyList(const std::vector<Span>& spans, Range range) const;
+
+	public:
+		// The texts are decoded as they're copied. Throw std::length_error if the tree's too
+		// large to be numbered by a Index.
+		explicit FlatDocument(const DOM::NodeWithChildren& tree);
+
+		Index size() const
+		{
+			return (Index)types.size();
+		}
+
+		DOM::Node::Type getType(Index node) const
+		{
+			return types[node];
+		}
+
+		Index getParent(Index node) const
+		{
+			return parents[node];
+		}
+
+		Index getFirstChild(Index node) const
+		{
+			return firstChildren[node];
+		}
+
+		Index getNextSibling(Index node) const
+		{
+			return nextSiblings[node];
+		}
+
+		// One past the last node in the subtree of a node.
+		Index getSubtreeEnd(Index node) const
+		{
+			return subtreeEnds[node];
+		}
+
+		// Empty for a node other than a element.
+		std::string_view getTagName(Index node) const
+		{
+			return types[node] == DOM::Node::Type::Element ? getString(texts[node]) : std::string_view();
+		}
+
+		Atom getTagAtom(Index node) const
+		{
+			return tagAtoms[node];
+		}
+
+		// The content of a text or comment node, or empty for other nodes.
+		std::string_view getContent(Index node) const
+		{
+			return types[node] == DOM::Node::Type::Element ? std::string_view() : getString(texts[node]);
+		}
+
+		// These work like HTMLDocument's and its Elements', on the subtree of a node -- of
+		// the root for the whole document. The views are into the document.
+
+		std::string getTextContent(Index node = root) const;
+		std::string getDirectTextContent(Index node = root) const;
+		std::string_view getAttribute(Index node, const std::string& name) const;
+		std::unordered_set<std::string> getClassList(Index node) const;
+		std::unordered_set<std::string> getIdList(Index node) const;
+		Index getElementById(const std::string& id, Index node = root) const;
+		std::vector<Index> getElementsByName(const std::string& name, Index node = root) const;
+		std::vector<Index> getElementsByTagName(const std::string& tagName, Index node = root) const;
+		std::vector<Index> getElementsByClassName(const std::string& className, Index node = root) const;
+		std::vector<Index> getChildren(Index node = root) const;
+	};
+}
+
+#endif // _MENCI_HTML_PARSER_FLATDOCUMENT_H
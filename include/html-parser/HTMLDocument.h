@@ -3,8 +3,10 @@
 
 #include <istream>
 #include <memory>
+#include <memory_resource>
 #include <type_traits>
 #include <string>
+#include <unordered_set>
 
 #include "macros.h"
 
@@ -12,11 +14,27 @@
 #include "DOM.h"
 #include "DOMBuilder.h"
 #include "DOMInspector.h"
+#include "FlatDocument.h"
+#include "ParseOptions.h"
 
 namespace html_parser {
 	class HTMLDocument
 	{
-		DOM::RootNode domRoot;
+		friend class IncrementalParser;
+		friend class HTMLParser;
+
+		// Where the arenas of the DOM trees parsed are allocated from.
+		std::pmr::memory_resource* memory;
+		ParseOptions options;
+
+		// Never null. Elements share the ownership of it, so they outlive the document.
+		std::shared_ptr<DOM::RootNode> domRoot;
+
+		HTMLDocument(std::pmr::memory_resource* memory, const ParseOptions& options)
+			: memory(memory), options(options), domRoot(std::make_shared<DOM::RootNode>(memory)) {}
+
+		HTMLDocument(std::pmr::memory_resource* memory, const ParseOptions& options, std::shared_ptr<DOM::RootNode> domRoot)
+			: memory(memory), options(options), domRoot(std::move(domRoot)) {}
 
 	public:
 		class Element
@@ -37,6 +55,8 @@ namespace html_parser {
 			Element() = default;
 			Element(const Element&) = default;
 			Element(Element&&) = default;
+
+			// The node shares the ownership of its tree.
 			explicit Element(const std::shared_ptr<DOM::ElementNode> node) : node(node) {}
 
 			void inspect() const
@@ -71,7 +91,7 @@ namespace html_parser {
 			{
 				checkNotNull();
 				std::vector<Element> result;
-				HTMLDocument::internelGetElementsByTagName(node.get(), tagName, result);
+				HTMLDocument::internelGetElementsByTagName(node, node.get(), tagName, findAtom(tagName), result);
 				return result;
 			}
 
@@ -79,7 +99,7 @@ namespace html_parser {
 			{
 				checkNotNull();
 				std::vector<Element> result;
-				HTMLDocument::internelGetElementsByClassName(node.get(), className, result);
+				HTMLDocument::internelGetElementsByClassName(node, node.get(), className, result);
 				return result;
 			}
 
@@ -87,23 +107,23 @@ namespace html_parser {
 			{
 				checkNotNull();
 				std::vector<Element> result;
-				HTMLDocument::internelGetChildren(node.get(), result);
+				HTMLDocument::internelGetChildren(node, node.get(), result);
 				return result;
 			}
 
 			std::unordered_set<std::string> getClassList()
 			{
-				return this->node->classList;
+				return HTMLDocument::copyStringSet(this->node->getClassList());
 			}
 
 			std::unordered_set<std::string> getIdList()
 			{
-				return this->node->idList;
+				return HTMLDocument::copyStringSet(this->node->getIdList());
 			}
 
 			std::string getTagName()
 			{
-				return this->node->tagName;
+				return std::string(this->node->tagName);
 			}
 
 			operator bool() const
@@ -113,78 +133,122 @@ namespace html_parser {
 		};
 
 	private:
-		static Element internelGetElementById(const DOM::NodeWithChildren* node, const std::string& id);
-		static void internelGetElementsByName(const DOM::NodeWithChildren* node, const std::string& name, std::vector<Element>& result);
-		static void internelGetElementsByTagName(const DOM::NodeWithChildren* node, const std::string& tagName, std::vector<Element>& result);
-		static void internelGetElementsByClassName(const DOM::NodeWithChildren* node, const std::string& className, std::vector<Element>& result);
+		// The Elements found share the ownership of the tree with tree.
+		static Element internelGetElementById(const std::shared_ptr<DOM::NodeWithChildren>& tree, const DOM::NodeWithChildren* node, const std::string& id);
+		static void internelGetElementsByName(const std::shared_ptr<DOM::NodeWithChildren>& tree, const DOM::NodeWithChildren* node, const std::string& name, std::vector<Element>& result);
+		static void internelGetElementsByTagName(const std::shared_ptr<DOM::NodeWithChildren>& tree, const DOM::NodeWithChildren* node, const std::string& tagName, Atom tagAtom, std::vector<Element>& result);
+		static void internelGetElementsByClassName(const std::shared_ptr<DOM::NodeWithChildren>& tree, const DOM::NodeWithChildren* node, const std::string& className, std::vector<Element>& result);
 		static void internelGetTextContent(const DOM::NodeWithChildren* node, std::string& result);
 		static void internelGetDirectTextContent(const DOM::NodeWithChildren* node, std::string& result);
-		static void internelGetChildren(const DOM::NodeWithChildren* node, std::vector<Element>& result);
+		static void internelGetChildren(const std::shared_ptr<DOM::NodeWithChildren>& tree, const DOM::NodeWithChildren* node, std::vector<Element>& result);
 		static std::string internelGetAttribute(const DOM::ElementNode* node, const std::string& name);
+		static std::unordered_set<std::string> copyStringSet(const std::pmr::vector<std::string_view>& list);
 
 	public:
+		// The DOM tree is allocated from a arena on top of memory, which must outlive the
+		// document and its Elements. It's freed in a few big blocks, not node by node. The
+		// options are used by every parse of the document.
 		template <typename T, typename = std::enable_if_t<std::is_base_of_v<std::istream, std::remove_reference_t<T>>>>
-		explicit HTMLDocument(T&& is) : HTMLDocument(std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>())) {}
+		explicit HTMLDocument(T&& is, std::pmr::memory_resource* memory = std::pmr::get_default_resource(),
+			const ParseOptions& options = ParseOptions())
+			: HTMLDocument(memory, options)
+		{
+			parse(is);
+		}
 
-		explicit HTMLDocument(const std::string& html)
+		explicit HTMLDocument(const std::string& html, std::pmr::memory_resource* memory = std::pmr::get_default_resource(),
+			const ParseOptions& options = ParseOptions())
+			: HTMLDocument(memory, options)
 		{
 			parse(html);
 		}
 
 		void parse(const std::string& html)
 		{
-			domRoot = buildDOM(getTokens(html));
+			domRoot = buildDOM(TokenStream(html), memory, options);
 		}
 
+		// Parse the stream chunk by chunk, without reading it into a string first.
+		void parse(std::istream& is);
+
+		// Parse within limits, stopping at the first one passed. The document is then what's
+		// parsed until there, and the limit passed is returned.
+		ParseStatus parse(const std::string& html, const ParseLimits& limits);
+
+		// Parse on up to threadCount threads, 0 for one on each core. The DOM tree is the same
+		// as parse() gives. It only pays off for documents of megabytes. The threads allocate
+		// from the memory resource at once, so it must be thread-safe.
+		void parseParallel(const std::string& html, unsigned threadCount = 0);
+
+		// Parse with the lexer on another thread, overlapping with building the DOM tree on
+		// this thread. The DOM tree is the same as parse() gives.
+		void parsePipelined(const std::string& html)
+		{
+			domRoot = buildDOMPipelined(TokenStream(html), memory, options);
+		}
+
+		// Parse a file, "-" for stdin. A regular file is lexed right from a memory mapping of
+		// it, and anything else is read and parsed chunk by chunk. Throw std::system_error if
+		// the file can't be opened or read.
+		static HTMLDocument fromFile(const std::string& path,
+			std::pmr::memory_resource* memory = std::pmr::get_default_resource(),
+			const ParseOptions& options = ParseOptions());
+
 		void inspect() const
 		{
-			inspectNode(&domRoot);
+			inspectNode(domRoot.get());
+		}
+
+		// Copy the DOM tree to a flat, read-only layout, which is faster to search.
+		FlatDocument flatten() const
+		{
+			return FlatDocument(*domRoot);
 		}
 
 		std::string getTextContent() const
 		{
 			std::string result;
-			HTMLDocument::internelGetTextContent(&domRoot, result);
+			HTMLDocument::internelGetTextContent(domRoot.get(), result);
 			return result;
 		}
 
 		std::string getDirectTextContent() const
 		{
 			std::string result;
-			HTMLDocument::internelGetDirectTextContent(&domRoot, result);
+			HTMLDocument::internelGetDirectTextContent(domRoot.get(), result);
 			return result;
 		}
 
 		Element getElementById(const std::string& id) const
 		{
-			return HTMLDocument::internelGetElementById(&domRoot, id);
+			return HTMLDocument::internelGetElementById(domRoot, domRoot.get(), id);
 		}
 
 		std::vector<Element> getElementsByName(const std::string& name) const
 		{
 			std::vector<Element> result;
-			HTMLDocument::internelGetElementsByName(&domRoot, name, result);
+			HTMLDocument::internelGetElementsByName(domRoot, domRoot.get(), name, result);
 			return result;
 		}
 
 		std::vector<Element> getElementsByTagName(const std::string& tagName) const
 		{
 			std::vector<Element> result;
-			HTMLDocument::internelGetElementsByTagName(&domRoot, tagName, result);
+			HTMLDocument::internelGetElementsByTagName(domRoot, domRoot.get(), tagName, findAtom(tagName), result);
 			return result;
 		}
 
 		std::vector<Element> getElementsByClassName(const std::string& className) const
 		{
 			std::vector<Element> result;
-			HTMLDocument::internelGetElementsByClassName(&domRoot, className, result);
+			HTMLDocument::internelGetElementsByClassName(domRoot, domRoot.get(), className, result);
 			return result;
 		}
 
 		std::vector<Element> getChildren() const
 		{
 			std::vector<Element> result;
-			HTMLDocument::internelGetChildren(&domRoot, result);
+			HTMLDocument::internelGetChildren(domRoot, domRoot.get(), result);
 			return result;
 		}
 	};
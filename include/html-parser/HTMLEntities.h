@@ -7,9 +7,13 @@
 #include <memory>
 
 #include <string>
+#include <string_view>
 
 namespace html_parser {
-	std::string decodeHTMLEntites(const std::string& text);
+	std::string decodeHTMLEntites(std::string_view text);
+
+	// Append the text decoded to result.
+	void decodeHTMLEntites(std::string_view text, std::string& result);
 }
 
 #endif // _MENCI_HTML_PARSER_HTMLENTITIES_H
@@ -0,0 +1,88 @@
+#ifndef _MENCI_HTML_PARSER_HTMLPARSER_H
+#define _MENCI_HTML_PARSER_HTMLPARSER_H
+
+#include <istream>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "Lexer.h"
+#include "DOMBuilder.h"
+#include "HTMLDocument.h"
+#include "ParseOptions.h"
+
+namespace html_parser {
+	// Parses document after document, e.g. on a worker thread owning it, reusing its memory
+	// instead of allocating it again for every document. The lexer's and builder's buffers
+	// are kept between parses, and the blocks of a document's arena are kept when it's
+	// released, for the documents parsed next. Parsing documents of similar sizes then
+	// hardly calls the memory resource at all.
+	//
+	// The parser must outlive the documents it parses and their Elements. They can be
+	// released on any thread.
+	class HTMLParser
+	{
+		// Keeps the blocks given back for the allocations of the same size and alignment,
+		// which the arenas of documents make in the same order every time.
+		class BlockCache : public std::pmr::memory_resource
+		{
+			struct Block
+			{
+				void* pointer;
+				size_t size, alignment;
+			};
+
+			std::pmr::memory_resource* upstream;
+			std::vector<Block> blocks;
+			std::mutex mutex;
+
+		protected:
+			void* do_allocate(size_t size, size_t alignment) override;
+			void do_deallocate(void* pointer, size_t size, size_t alignment) override;
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+		public:
+			explicit BlockCache(std::pmr::memory_resource* upstream) : upstream(upstream) {}
+			~BlockCache();
+		};
+
+		BlockCache memory;
+		ParseOptions options;
+
+		// Created with the first document.
+		std::optional<DOMBuilder> builder;
+		TagParts parts;
+
+		// For documents read from a stream.
+		IncrementalLexer lexer;
+		std::vector<Token> tokens;
+		std::vector<char> chunk;
+
+		std::shared_ptr<DOM::RootNode> createRoot();
+
+	public:
+		// The memory is allocated from memory when there's none to reuse, and given back
+		// when the parser is destroyed. The options are used for every document.
+		explicit HTMLParser(std::pmr::memory_resource* memory = std::pmr::get_default_resource(),
+			const ParseOptions& options = ParseOptions());
+		HTMLParser(const HTMLParser&) = delete;
+		HTMLParser& operator=(const HTMLParser&) = delete;
+
+		// The document is built in one pass over the contents, as by HTMLDocument.
+		HTMLDocument parse(std::string_view html);
+
+		// Parse the stream chunk by chunk, without reading it into a string first.
+		HTMLDocument parse(std::istream& is);
+
+		// Parse within limits, stopping at the first one passed, as HTMLDocument::parse()
+		// does. The limit passed is set to status, or Complete.
+		HTMLDocument parse(std::string_view html, const ParseLimits& limits, ParseStatus& status);
+
+		// The same, reading no more of the stream than the input's limit and a chunk.
+		HTMLDocument parse(std::istream& is, const ParseLimits& limits, ParseStatus& status);
+	};
+}
+
+#endif // _MENCI_HTML_PARSER_HTMLPARSER_H
@@ -0,0 +1,46 @@
+#ifndef _MENCI_HTML_PARSER_INCREMENTALPARSER_H
+#define _MENCI_HTML_PARSER_INCREMENTALPARSER_H
+
+#include <string_view>
+#include <vector>
+
+#include "Lexer.h"
+#include "DOMBuilder.h"
+#include "HTMLDocument.h"
+
+namespace html_parser {
+	// Parses a HTML document fed in chunks, e.g. while it's still being downloaded. The DOM
+	// tree grows with every token completed by a chunk, and only the contents after the last
+	// complete token are kept in memory.
+	class IncrementalParser
+	{
+		HTMLDocument document;
+		IncrementalLexer lexer;
+		DOMBuilder builder;
+		std::vector<Token> tokens;
+		bool finished = false;
+
+		void buildTokens();
+
+	public:
+		// The DOM tree is allocated from a arena on top of memory, as by HTMLDocument.
+		explicit IncrementalParser(std::pmr::memory_resource* memory = std::pmr::get_default_resource(),
+			const ParseOptions& options = ParseOptions());
+		IncrementalParser(const IncrementalParser&) = delete;
+		IncrementalParser& operator=(const IncrementalParser&) = delete;
+
+		// Parse the next chunk of the document.
+		void feed(std::string_view chunk);
+
+		// Parse what's left as the document ends, and take the document.
+		HTMLDocument finish();
+
+		// The document parsed so far.
+		const HTMLDocument& getDocument() const
+		{
+			return document;
+		}
+	};
+}
+
+#endif // _MENCI_HTML_PARSER_INCREMENTALPARSER_H
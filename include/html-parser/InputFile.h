@@ -0,0 +1,49 @@
+#ifndef _MENCI_HTML_PARSER_INPUTFILE_H
+#define _MENCI_HTML_PARSER_INPUTFILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace html_parser {
+	// A file opened to be parsed, "-" for stdin. A regular file is memory-mapped, so it can
+	// be lexed right from the mapping. Anything else (pipes, terminals, sockets) can't be
+	// mapped and is read in chunks instead.
+	class InputFile
+	{
+#ifdef _WIN32
+		void* file = nullptr;
+		void* fileMapping = nullptr;
+#else
+		int fd = -1;
+#endif
+		bool ownsFile = false;
+		bool mapped = false;
+
+		const char* mapping = nullptr;
+		size_t size = 0;
+
+	public:
+		// Throw std::system_error if the file can't be opened.
+		explicit InputFile(const std::string& path);
+		InputFile(const InputFile&) = delete;
+		InputFile& operator=(const InputFile&) = delete;
+		~InputFile();
+
+		bool isMapped() const
+		{
+			return mapped;
+		}
+
+		// The whole contents of a mapped file, valid until the file is destroyed.
+		std::string_view getContents() const
+		{
+			return std::string_view(mapping, size);
+		}
+
+		// Read the next chunk of a file not mapped, up to size bytes. Return 0 at the end.
+		size_t read(char* buffer, size_t size);
+	};
+}
+
+#endif // _MENCI_HTML_PARSER_INPUTFILE_H
@@ -2,13 +2,166 @@
 #define _MENCI_HTML_PARSER_LEXER_H
 
 #include <vector>
+#include <iterator>
+#include <cstddef>
 #include <string>
+#include <string_view>
 #include "macros.h"
 
 #include "Token.h"
 
 namespace html_parser {
-	std::vector<Token> getTokens(const std::string& htmlContents);
+	// Lexes HTML contents one token at a time, as the tokens are pulled, giving the same
+	// tokens as getTokens(). The tokens are views into htmlContents, so it must outlive them.
+	//
+	// It's also an input range, to be consumed once:
+	//
+	//     for (const Token& token : TokenStream(htmlContents)) { ... }
+	class TokenStream
+	{
+		std::string_view input;
+
+		// Whether more contents may be appended to the input (by IncrementalLexer). If not
+		// final, whatever depends on the contents after the input is not lexed.
+		bool final;
+
+		// Where the next token starts, and where the search for '<' resumes.
+		size_t searchStart, pos;
+
+		// Start of a tag-like token found right after a text token, given next. Its end is
+		// searchStart. npos if there's none.
+		size_t pendingTag = std::string_view::npos;
+
+		// Position of the last '>' in the input, npos if there's no '>' at all.
+		size_t lastTagClose;
+
+		// The latest searches for a comment's end and the closing quotes: there's none from
+		// where the search started up to where it stopped, so a later search starting
+		// between them resumes from there.
+		struct Search
+		{
+			size_t from = 0, next = 0;
+		};
+
+		Search commentEnd, doubleQuote, singleQuote;
+
+		// The raw text element whose contents start at searchStart, right after its open
+		// tag, or empty. Its contents up to its close tag are given as one text token.
+		std::string_view rawTextTag;
+
+		TokenStream(std::string_view input, size_t searchStart, size_t pos, bool final, size_t lastTagClose);
+
+		size_t findClosingQuote(char quote, size_t from);
+		size_t matchComment(size_t pos);
+		size_t matchTag(size_t pos, TagParts* parts);
+		bool mayMatchFrom(size_t pos) const;
+		size_t findRawTextEnd();
+		bool lexRawText(Token& token);
+		bool lex(Token& token, TagParts* parts);
+
+		friend class IncrementalLexer;
+		friend std::vector<Token> getTokensParallel(std::string_view htmlContents, unsigned threadCount);
+
+	public:
+		explicit TokenStream(std::string_view htmlContents);
+
+		// Lex htmlContents from start, as if a token starts there. If one of the tokens of the
+		// whole contents does start there, the tokens are the same as the whole contents'.
+		TokenStream(std::string_view htmlContents, size_t start);
+
+		// Lex the next token. Return false if there's no more.
+		bool next(Token& token);
+
+		// The same, also extracting the parts of a open or close tag token while lexing it.
+		// The parts of a tag right after a text token are extracted along with the text, so
+		// the same parts must be passed to every call. Not available with the regex lexer.
+		bool next(Token& token, TagParts& parts);
+
+		class iterator
+		{
+			TokenStream* stream;
+			Token token;
+
+		public:
+			using iterator_category = std::input_iterator_tag;
+			using value_type = Token;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const Token*;
+			using reference = const Token&;
+
+			// The end iterator.
+			iterator() : stream(nullptr), token(Token::Type::Text, std::string_view()) {}
+
+			explicit iterator(TokenStream* stream) : iterator()
+			{
+				this->stream = stream;
+				++*this;
+			}
+
+			reference operator*() const { return token; }
+			pointer operator->() const { return &token; }
+
+			iterator& operator++()
+			{
+				if (!stream->next(token))
+				{
+					stream = nullptr;
+				}
+
+				return *this;
+			}
+
+			// Only the position in the stream matters, which the iterators share.
+			bool operator==(const iterator& other) const { return stream == other.stream; }
+			bool operator!=(const iterator& other) const { return stream != other.stream; }
+		};
+
+		iterator begin() { return iterator(this); }
+		iterator end() { return iterator(); }
+	};
+
+	// The returned tokens are views into htmlContents, so it must outlive them. The contents
+	// of a raw text element, like <script>, are one text token up to its close tag.
+	std::vector<Token> getTokens(std::string_view htmlContents);
+
+	// Lex on up to threadCount threads, giving the same tokens as getTokens(). The contents
+	// are split into segments lexed speculatively from a '<', and the segments are joined
+	// where they agree with the tokens before. A small document is lexed on this thread.
+	std::vector<Token> getTokensParallel(std::string_view htmlContents, unsigned threadCount);
+
+	// Lexes HTML contents fed in chunks, giving the same tokens as getTokens() does on the
+	// whole contents. A token is given once it's complete, so only the contents after the
+	// last complete token are kept.
+	class IncrementalLexer
+	{
+		std::string buffer;
+
+		// Where the next token starts, and where the search for '<' resumes.
+		size_t searchStart = 0, pos = 0;
+
+		// The raw text element whose contents start at searchStart, or empty.
+		std::string_view rawTextTag;
+
+		// The last '>' in the buffer and the results of the stream's searches, kept across
+		// the chunks so the contents before are not searched again.
+		size_t lastTagClose = std::string_view::npos;
+		TokenStream::Search commentEnd, doubleQuote, singleQuote;
+
+		bool checkedBOM = false;
+
+		void append(std::string_view chunk);
+		bool checkBOM(bool final);
+		void lex(bool final, std::vector<Token>& tokens);
+
+	public:
+		// Append a chunk of the contents, and lex the tokens completed by it. The tokens are
+		// views into the lexer's buffer, valid until the next call to feed() or finish().
+		void feed(std::string_view chunk, std::vector<Token>& tokens);
+
+		// Lex everything left as the contents end. The lexer is then ready for another
+		// document.
+		void finish(std::vector<Token>& tokens);
+	};
 }
 
 #endif // _MENCI_HTML_PARSER_LEXER_H
@@ -0,0 +1,91 @@
+#ifndef _MENCI_HTML_PARSER_PARSEOPTIONS_H
+#define _MENCI_HTML_PARSER_PARSEOPTIONS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace html_parser {
+	// Selects the elements with the given tag name, id and class, each only if not empty --
+	// e.g. { "table", "", "prices" } for <table class="prices">.
+	struct ElementSelector
+	{
+		std::string tagName, id, className;
+	};
+
+	// Options of how a document is parsed into a DOM tree. The defaults parse everything.
+	struct ParseOptions
+	{
+		// Keep the text of each tag and parse its attributes, class and id lists only when
+		// one of them is first read, e.g. by getAttribute(). Parsing them then costs more than
+		// while lexing, so it pays off only if most elements' attributes are never read --
+		// searching by id, name or class reads those of every element searched.
+		bool lazyAttributes = false;
+
+		// If not empty, only the elements selected by any of these are kept, with their
+		// subtrees, as children of the root. The rest of the document is still parsed to get
+		// its structure right, but nothing of it is allocated. It's built on one thread.
+		std::vector<ElementSelector> keepSubtrees;
+
+		// Keep the ancestors of the elements selected too, in their places, but without
+		// their other children.
+		bool keepAncestors = false;
+
+		// The switches below save the memory of what's not needed, e.g. for scraping.
+
+		// Don't keep comments.
+		bool dropComments = false;
+
+		// What's done with the texts of only whitespaces, as between tags: they're kept,
+		// dropped, or collapsed to a single space.
+		enum class WhitespaceText : unsigned char
+		{
+			Keep,
+			Drop,
+			Collapse
+		};
+		WhitespaceText whitespaceText = WhitespaceText::Keep;
+
+		// Don't keep the texts of script and style elements, only the elements.
+		bool dropScriptAndStyleText = false;
+
+		// If set, only the attributes with these (lowered) names are kept -- class and id
+		// too, only if listed. The others aren't copied to the tree at all.
+		std::optional<std::vector<std::string>> attributeAllowlist;
+	};
+
+	// Limits of a parse, to bound the time and memory any document can take. The parse stops
+	// at the first limit passed, keeping what's built until then.
+	struct ParseLimits
+	{
+		// Checked every few hundred tokens. No time limit if not set.
+		std::optional<std::chrono::steady_clock::time_point> deadline;
+
+		// The contents after these are not parsed at all, as if the document ended there.
+		size_t maxInputBytes = SIZE_MAX;
+
+		// Checked after each token, so the document keeps the nodes of the token which went
+		// past one: a element maxDepth + 1 deep, or a few nodes more than maxNodes. The nodes
+		// are those in the tree, and the depth is the elements open, including those not kept.
+		size_t maxNodes = SIZE_MAX, maxDepth = SIZE_MAX;
+
+		// Set to true, e.g. from another thread, to stop the parse. Checked with the deadline.
+		const std::atomic<bool>* cancelled = nullptr;
+	};
+
+	// How a parse within limits ended.
+	enum class ParseStatus : unsigned char
+	{
+		Complete,
+		InputTooLarge,
+		TooManyNodes,
+		TooDeep,
+		DeadlineExceeded,
+		Cancelled
+	};
+}
+
+#endif // _MENCI_HTML_PARSER_PARSEOPTIONS_H
@@ -0,0 +1,56 @@
+#ifndef _MENCI_HTML_PARSER_SPSCQUEUE_H
+#define _MENCI_HTML_PARSER_SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace html_parser {
+	// A bounded lock-free queue between exactly one producer thread and one consumer thread.
+	//
+	// Items are swapped in and out of the slots instead of copied, so what's given back to
+	// the caller is the item left by the other side. With containers as items, their buffers
+	// go round in the queue and are never reallocated.
+	template <typename T, size_t capacity>
+	class SPSCQueue
+	{
+		static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0, "The capacity must be a power of 2");
+
+		T slots[capacity];
+
+		// Kept on separate cache lines, as each is written by one side and read by the other.
+		alignas(64) std::atomic<size_t> head{ 0 }; // The next slot to pop, written by the consumer.
+		alignas(64) std::atomic<size_t> tail{ 0 }; // The next slot to push, written by the producer.
+
+	public:
+		// Called by the producer. Return false if the queue is full.
+		bool tryPush(T& item)
+		{
+			size_t currentTail = tail.load(std::memory_order_relaxed);
+			if (currentTail - head.load(std::memory_order_acquire) == capacity)
+			{
+				return false;
+			}
+
+			std::swap(slots[currentTail & (capacity - 1)], item);
+			tail.store(currentTail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Called by the consumer. Return false if the queue is empty.
+		bool tryPop(T& item)
+		{
+			size_t currentHead = head.load(std::memory_order_relaxed);
+			if (currentHead == tail.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+
+			std::swap(item, slots[currentHead & (capacity - 1)]);
+			head.store(currentHead + 1, std::memory_order_release);
+			return true;
+		}
+	};
+}
+
+#endif // _MENCI_HTML_PARSER_SPSCQUEUE_H
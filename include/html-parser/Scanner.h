@@ -0,0 +1,49 @@
+#ifndef _MENCI_HTML_PARSER_SCANNER_H
+#define _MENCI_HTML_PARSER_SCANNER_H
+
+#include <cstddef>
+
+namespace html_parser {
+	// A small set of delimiter characters to search for. Up to 4 characters, plus all
+	// whitespaces (' ', '\t', '\n', '\v', '\f' and '\r') optionally.
+	struct DelimiterSet
+	{
+		char characters[4];
+		bool whitespace;
+
+		// Unused slots are filled with the first character so the SIMD kernels can always
+		// compare against all 4 slots.
+		constexpr DelimiterSet(const char* delimiters, bool whitespace = false)
+			: characters{ 0, 0, 0, 0 }, whitespace(whitespace)
+		{
+			size_t count = 0;
+			while (count < 4 && delimiters[count] != '\0')
+			{
+				characters[count] = delimiters[count];
+				count++;
+			}
+
+			for (size_t i = count; i < 4; i++)
+			{
+				characters[i] = characters[0];
+			}
+		}
+
+		constexpr bool contains(char ch) const
+		{
+			return ch == characters[0] || ch == characters[1] || ch == characters[2] || ch == characters[3]
+				|| (whitespace && (ch == ' ' || (ch >= '\t' && ch <= '\r')));
+		}
+	};
+
+	// Find the first delimiter in [begin, end). Return end if not found.
+	//
+	// It's SIMD-accelerated (SSE2 or AVX2, chosen at runtime by what the CPU supports) to
+	// skip over long runs of text and attribute values 16 or 32 bytes at a time.
+	const char* findDelimiter(const char* begin, const char* end, const DelimiterSet& delimiters);
+
+	// The name of the implementation findDelimiter() uses on this CPU: "avx2", "sse2" or "scalar".
+	const char* getScannerImplementation();
+}
+
+#endif // _MENCI_HTML_PARSER_SCANNER_H
@@ -1,7 +1,8 @@
 #ifndef _MENCI_HTML_PARSER_TOKEN_H
 #define _MENCI_HTML_PARSER_TOKEN_H
 
-#include <string>
+#include <string_view>
+#include <vector>
 
 namespace html_parser {
     struct Token
@@ -12,9 +13,24 @@ namespace html_parser {
             Text
         } type;
 
-        std::string content;
+        // A view into the lexed HTML contents, which must outlive the token.
+        std::string_view content;
 
-        Token(Type type, std::string content) : type(type), content(content) {}
+        Token(Type type, std::string_view content) : type(type), content(content) {}
+    };
+
+    // The parts of a open or close tag token, extracted while lexing it. Like the token,
+    // they're views into the lexed HTML contents.
+    struct TagParts
+    {
+        struct Attribute
+        {
+            std::string_view name, value;
+        };
+
+        // Without the '/' of a close tag, and not lowered.
+        std::string_view name;
+        std::vector<Attribute> attributes;
     };
 }
 
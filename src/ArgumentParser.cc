@@ -236,7 +236,7 @@ namespace html_parser {
 					}
 
 					auto it = mapNameArgument.find(name.substr(2));
-					if (mapNameArgument.end().operator==(it))
+					if (it == mapNameArgument.end())
 					{
 						raiseError("Unknown option: " + name + '.');
 					}
@@ -253,7 +253,7 @@ namespace html_parser {
 					}
 
 					auto it = mapAliasArgument.find(name.substr(1));
-					if (mapAliasArgument.end().operator==(it))
+					if (it == mapAliasArgument.end())
 					{
 						raiseError("Unknown option: " + name + '.');
 					}
@@ -1,288 +1,1040 @@
 #include "DOMBuilder.h"
 
-#include "HTMLEntities.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <future>
+#include <optional>
+#include <thread>
+
+#include "Atoms.h"
+#include "SPSCQueue.h"
 
 namespace html_parser {
-	// These elements' open tags don't need close tags and they don't have a subtree.
-	// From https://developer.mozilla.org/en-US/docs/Glossary/Empty_element.
-	static const char* const emptyElements[] = {
-		"area",
-		"base",
-		"br",
-		"col",
-		"colgroup",
-		"command",
-		"embed",
-		"hr",
-		"img",
-		"input",
-		"keygen",
-		"link",
-		"meta",
-		"param",
-		"source",
-		"track",
-		"wbr" };
-
-	// These elements don't contain any child elements. Everything inside them is
-	// just a TextNode.
-	// From https://www.w3.org/TR/html5/syntax.html#writing-html-documents-elements.
-	static const char* const rawTextElements[] = {
-		"script",
-		"style",
-		"textarea",
-		"title" };
-
-	// These raw text elements contain escaped string -- e.g. &nbsp; will be replaced
-	// with a space ' ' in these elements but not in other raw text elements.
-	// From https://www.w3.org/TR/html5/syntax.html#writing-html-documents-elements.
-	static const char* const escapableRawTextElements[] = {
-		"textarea",
-		"title" };
-
-	inline void tokenize(std::string str, const char delimiter, std::vector<std::string>& out)
-	{
-		int start = 0;
-		int end = str.find(delimiter);
-		while (end != -1)
+	template <typename Container>
+	inline void tokenize(std::string_view str, const char delimiter, Container& out)
+	{
+		size_t start = 0;
+		size_t end = str.find(delimiter);
+		while (end != std::string_view::npos)
 		{
 			out.push_back(str.substr(start, end - start));
 			start = end + 1;
 			end = str.find(delimiter, start);
 		}
-		out.push_back(str.substr(start, end - start));
+		out.push_back(str.substr(start));
 	}
 
-	static void parseTagOpen(const std::string& token, std::string& tagName, std::unordered_map<std::string, std::string>& attributes, std::unordered_set<std::string>& classList, std::unordered_set<std::string>& idList)
+	static constexpr Atom classAtom = findAtom("class"),
+		idAtom = findAtom("id");
+
+	// The values of a tag's class and id attributes, which go to the lists instead.
+	struct ClassAndIdValues
 	{
-		// Extract tag name and all attributes.
-		// ^<(\S+)\s*([\S\s]*)>$
-		static const regex reTag(
-			"^<(\\S+)\\s*([\\S\\s]*)>$");
+		std::optional<std::string_view> classValue, idValue;
+	};
 
-		match_results match;
-		if (!regex_search(token.begin(), token.end(), match, reTag))
+	// Set a attribute of a element, unless the tree's allowlist doesn't have it. HTML tag's
+	// attribute's name is case-insensitive.
+	static void setAttribute(DOM::RootNode& root, DOM::ElementNode& element, std::string_view name, std::string_view value, ClassAndIdValues& classAndId)
+	{
+		if (root.attributeAllowlist && std::none_of(root.attributeAllowlist->begin(), root.attributeAllowlist->end(), [&](const std::string& allowed) {
+				return equalsIgnoreCase(name, allowed);
+			}))
 		{
-			throw std::logic_error("Failed to apply regex on a tag open token");
+			return;
 		}
 
-		tagName = match[1].str();
-		std::string attributesString = match[2].str();
+		std::string_view key = root.storeLowered(name);
 
+		Atom atom = findAtom(key);
+		if (atom == classAtom)
+		{
+			classAndId.classValue = value;
+		}
+		else if (atom == idAtom)
+		{
+			classAndId.idValue = value;
+		}
+		else
+		{
+			element.setAttribute(key, root.store(value));
+		}
+	}
+
+	// Split the class and id attributes to the lists, sorted without duplicates.
+	static void splitClassAndIdLists(DOM::RootNode& root, DOM::ElementNode& element, const ClassAndIdValues& classAndId)
+	{
+		// The items are interned, so a token used by many elements is stored once.
+		auto split = [&](const std::optional<std::string_view>& value, std::pmr::vector<std::string_view>& list) {
+			if (!value)
+			{
+				return;
+			}
+
+			tokenize(*value, ' ', list);
+			std::sort(list.begin(), list.end());
+			list.erase(std::unique(list.begin(), list.end()), list.end());
+
+			for (std::string_view& item : list)
+			{
+				item = root.intern(item);
+			}
+		};
+
+		split(classAndId.classValue, element.classList);
+		split(classAndId.idValue, element.idList);
+	}
+
+	// Split a open tag to its name and the text of its attributes, as the regex
+	// ^<(\S+)\s*([\S\s]*)>$ would: the name is up to the first whitespace, and the
+	// attributes are after the whitespaces after it, up to the closing '>'.
+	static std::string_view splitTagOpen(std::string_view token, std::string_view& attributesString)
+	{
+		if (token.length() < 3 || token.front() != '<' || token.back() != '>' || isSpace(token[1]))
+		{
+			throw std::logic_error("Failed to parse a tag open token");
+		}
+
+		std::string_view contents = token.substr(1, token.length() - 2);
+		size_t nameEnd = std::find_if(contents.begin(), contents.end(), isSpace) - contents.begin();
+		size_t attributesStart = std::find_if_not(contents.begin() + nameEnd, contents.end(), isSpace) - contents.begin();
+
+		attributesString = contents.substr(attributesStart);
+		return contents.substr(0, nameEnd);
+	}
+
+	static void setTagName(DOM::RootNode& root, DOM::ElementNode& element, std::string_view name)
+	{
 		// HTML tag's name is case-insensitive.
-		tagName = to_lower(tagName);
+		element.tagName = root.storeLowered(name);
+		element.tagAtom = findAtom(element.tagName);
+	}
 
-		// Extract all attributes.
-		// ([^>\s][^>\s=]*)(?:\s*=\s*(?:(?:"([\S\s]*?)")|(?:'([\S\s]*?)')|([^\s>]+)))?\s*
-		static const regex reAttribute(
-			"([^>\\s][^>\\s=]*)(?:\\s*=\\s*(?:(?:\"([\\S\\s]*?)\")|(?:'([\\S\\s]*?)')|([^\\s>]+)))?\\s*");
+	// Call callback with the name and value of each attribute in the text of a open tag's
+	// attributes. It's one pass giving the same as searching the regex
+	//
+	// ([^>\s][^>\s=]*)(?:\s*=\s*(?:(?:"([\S\s]*?)")|(?:'([\S\s]*?)')|([^\s>]+)))?\s*
+	//
+	// again and again after its last match: a name, which may start with a '=', and if a
+	// '=' follows, a value quoted (if the quote is closed) or unquoted.
+	template <typename Callback>
+	static void forEachAttribute(std::string_view attributesString, Callback callback)
+	{
+		size_t length = attributesString.length();
+		auto skipSpaces = [&](size_t i) {
+			while (i < length && isSpace(attributesString[i]))
+			{
+				i++;
+			}
+			return i;
+		};
 
-		std::string::const_iterator searchStart = attributesString.cbegin();
-		while (regex_search(searchStart, attributesString.cend(), match, reAttribute))
+		for (size_t i = 0; i < length; )
 		{
-			std::string key = match[1].str(),
+			if (attributesString[i] == '>' || isSpace(attributesString[i]))
+			{
+				i++;
+				continue;
+			}
+
+			size_t nameStart = i++;
+			while (i < length && attributesString[i] != '>' && attributesString[i] != '=' && !isSpace(attributesString[i]))
+			{
+				i++;
+			}
+
+			std::string_view key = attributesString.substr(nameStart, i - nameStart),
 				value;
 
-			// A self-closing tag's close sign '/' is parsed to an attribute name
-			if (key != "/")
+			size_t equalsSign = skipSpaces(i);
+			size_t valueStart = equalsSign < length && attributesString[equalsSign] == '=' ? skipSpaces(equalsSign + 1) : length;
+			if (valueStart < length)
 			{
-				// 3 types: <"str">, <'str'> and <str>, in capture group 2, 3 and 4.
-				for (int i = 2; i <= 4; i++)
+				char quote = attributesString[valueStart];
+				size_t closingQuote = quote == '"' || quote == '\''
+					? attributesString.find(quote, valueStart + 1)
+					: std::string_view::npos;
+
+				if (closingQuote != std::string_view::npos)
 				{
-					if (match[i].length() > 0)
+					value = attributesString.substr(valueStart + 1, closingQuote - valueStart - 1);
+					i = closingQuote + 1;
+				}
+				else if (quote != '>')
+				{
+					// Unquoted, or its quote is not closed.
+					size_t valueEnd = valueStart;
+					while (valueEnd < length && attributesString[valueEnd] != '>' && !isSpace(attributesString[valueEnd]))
 					{
-						value = match[i].str();
-						break;
+						valueEnd++;
 					}
+
+					value = attributesString.substr(valueStart, valueEnd - valueStart);
+					i = valueEnd;
+				}
+			}
+
+			// A self-closing tag's close sign '/' is parsed to an attribute name
+			if (key != "/")
+			{
+				callback(key, value);
+			}
+		}
+	}
+
+	// The same, with the attributes from a tag's parts.
+	template <typename Callback>
+	static void forEachAttribute(const TagParts& parts, Callback callback)
+	{
+		for (const TagParts::Attribute& attribute : parts.attributes)
+		{
+			// A self-closing tag's close sign '/' is parsed to an attribute name
+			if (attribute.name != "/")
+			{
+				callback(attribute.name, attribute.value);
+			}
+		}
+	}
+
+	// Set the attributes of a element, from the text of them or from the tag's parts.
+	template <typename Attributes>
+	static void setAttributes(const Attributes& attributes, DOM::RootNode& root, DOM::ElementNode& element)
+	{
+		ClassAndIdValues classAndId;
+		forEachAttribute(attributes, [&](std::string_view name, std::string_view value) {
+			setAttribute(root, element, name, value, classAndId);
+		});
+
+		splitClassAndIdLists(root, element, classAndId);
+	}
+
+	// Set the attributes of a element from the text of its open tag.
+	static void parseTagAttributes(std::string_view tag, DOM::RootNode& root, DOM::ElementNode& element)
+	{
+#ifdef USE_REGEX_LEXER
+		std::string_view attributesString;
+		splitTagOpen(tag, attributesString);
+		setAttributes(attributesString, root, element);
+#else
+		// The tag is lexed by itself the same as in the document.
+		Token token(Token::Type::Text, std::string_view());
+		TagParts parts;
+		TokenStream(tag).next(token, parts);
+		setAttributes(parts, root, element);
+#endif
+	}
+
+	// Keep the text of a tag to parse its attributes from when they're first read.
+	static void deferAttributes(std::string_view tag, DOM::RootNode& root, DOM::ElementNode& element)
+	{
+		element.unparsedTag = root.store(tag);
+		element.unparsedTagRoot = &root;
+		element.attributesParsed.store(false, std::memory_order_relaxed);
+	}
+
+	void DOM::ElementNode::parseUnparsedTag()
+	{
+		RootNode& root = *unparsedTagRoot;
+		std::lock_guard<std::mutex> lock(root.lazyAttributesMutex);
+		if (attributesParsed.load(std::memory_order_relaxed))
+		{
+			// Parsed on another thread meanwhile.
+			return;
+		}
+
+		parseTagAttributes(unparsedTag, root, *this);
+
+		unparsedTag = std::string_view();
+		attributesParsed.store(true, std::memory_order_release);
+	}
+
+	// Whether a list of items separated by spaces, as a class or id attribute, has a item.
+	static bool listHasItem(std::string_view list, std::string_view item)
+	{
+		size_t start = 0;
+		for (size_t end; (end = list.find(' ', start)) != std::string_view::npos; start = end + 1)
+		{
+			if (list.substr(start, end - start) == item)
+			{
+				return true;
+			}
+		}
+
+		return list.substr(start) == item;
+	}
+
+	// The name of a close tag, as the regex </(.+?)[\s>] would give: from the "</" up to the
+	// first whitespace or '>' after it, at least one character. The first character isn't a
+	// line break, which '.' doesn't match -- then a later "</" is tried.
+	static std::string_view parseTagClose(std::string_view token)
+	{
+		for (size_t start = token.find("</"); start != std::string_view::npos; start = token.find("</", start + 1))
+		{
+			size_t nameStart = start + 2;
+			if (nameStart < token.length() && token[nameStart] != '\n' && token[nameStart] != '\r')
+			{
+				auto nameEnd = std::find_if(token.begin() + nameStart + 1, token.end(), [](char ch) {
+					return ch == '>' || isSpace(ch);
+				});
+
+				if (nameEnd == token.end())
+				{
+					// Nor is there after a later "</".
+					break;
 				}
 
-				// HTML tag's attribute's name is case-insensitive.
-				key = to_lower(key);
+				return token.substr(nameStart, nameEnd - token.begin() - nameStart);
+			}
+		}
+
+		throw std::logic_error("Failed to parse a tag close token");
+	}
+
+	// Whether a text has entities to decode when it's read.
+	static bool needsDecoding(std::string_view text)
+	{
+		return text.find('&') != std::string_view::npos;
+	}
+
+	bool DOMBuilder::isInRawText() const
+	{
+		return !openElements.empty() && isElementOfKind(openElements.back().tagAtom, RawTextElement);
+	}
 
-				attributes[key] = value;
+	// Whether the nodes appended now are kept.
+	bool DOMBuilder::isSelecting() const
+	{
+		return openElements.empty()
+			? options.keepSubtrees.empty()
+			: openElements.back().state == OpenElement::State::Selected;
+	}
+
+	// Whether a element opened out of the subtrees kept is selected to be kept, by its name
+	// and its attributes (from its parts if extracted).
+	bool DOMBuilder::isSelected(std::string_view tagName, const TagParts* parts, std::string_view attributesString) const
+	{
+		const std::vector<ElementSelector>& selectors = options.keepSubtrees;
+
+		// Its attributes are only looked through if needed.
+		ClassAndIdValues classAndId;
+		if (std::any_of(selectors.begin(), selectors.end(), [](const ElementSelector& selector) {
+				return !selector.id.empty() || !selector.className.empty();
+			}))
+		{
+			auto findClassAndId = [&](std::string_view name, std::string_view value) {
+				if (equalsIgnoreCase(name, "class"))
+				{
+					classAndId.classValue = value;
+				}
+				else if (equalsIgnoreCase(name, "id"))
+				{
+					classAndId.idValue = value;
+				}
+			};
+
+			if (parts != nullptr)
+			{
+				forEachAttribute(*parts, findClassAndId);
 			}
+			else
+			{
+				forEachAttribute(attributesString, findClassAndId);
+			}
+		}
+
+		auto hasItem = [](const std::optional<std::string_view>& list, const std::string& item) {
+			return item.empty() || (list && listHasItem(*list, item));
+		};
+
+		return std::any_of(selectors.begin(), selectors.end(), [&](const ElementSelector& selector) {
+			return (selector.tagName.empty() || equalsIgnoreCase(tagName, selector.tagName))
+				&& hasItem(classAndId.idValue, selector.id)
+				&& hasItem(classAndId.classValue, selector.className);
+		});
+	}
 
-			searchStart = match.suffix().first;
+	void DOMBuilder::pushOpenElement(const OpenElement& element, std::string_view tagName)
+	{
+		openElements.push_back(element);
+
+		if (element.tagAtom != unknownAtom)
+		{
+			openCounts[element.tagAtom]++;
+		}
+		else
+		{
+			unknownTagName.assign(tagName);
+			unknownOpenCounts[unknownTagName]++;
+		}
+	}
+
+	void DOMBuilder::openElement(DOM::ElementNode* node)
+	{
+		pushOpenElement(OpenElement{ node, currentNode, node->tagAtom, OpenElement::State::Selected, 0, 0, 0 }, node->tagName);
+		currentNode = node;
+	}
+
+	// Open a element filtered out, unless it's a empty element.
+	void DOMBuilder::skipElement(std::string_view tagName, std::string_view tag)
+	{
+		size_t tagsStart = skippedTags.length();
+		skippedTags += tagName;
+		std::transform(skippedTags.begin() + tagsStart, skippedTags.end(), skippedTags.begin() + tagsStart, toLowerAscii);
+
+		Atom tagAtom = findAtom(std::string_view(skippedTags).substr(tagsStart));
+		if (isElementOfKind(tagAtom, EmptyElement))
+		{
+			skippedTags.resize(tagsStart);
+			return;
+		}
+
+		// The tag is only needed to keep the element as a ancestor.
+		size_t tagLength = 0;
+		if (options.keepAncestors)
+		{
+			skippedTags += tag;
+			tagLength = tag.length();
 		}
-		if (attributes.find("class") != attributes.end())
+
+		pushOpenElement(OpenElement{ nullptr, currentNode, tagAtom, OpenElement::State::Skipped, tagsStart, tagName.length(), tagLength },
+			std::string_view(skippedTags).substr(tagsStart, tagName.length()));
+	}
+
+	// Add the skipped elements left open to the tree, as the ancestors of a element selected.
+	void DOMBuilder::keepSkippedAncestors()
+	{
+		for (OpenElement& element : openElements)
 		{
-			std::vector<std::string> classes;
-			tokenize(attributes["class"], ' ', classes);
+			if (element.state != OpenElement::State::Skipped)
+			{
+				continue;
+			}
+
+			std::string_view tag = std::string_view(skippedTags).substr(element.tagsStart + element.nameLength, element.tagLength);
+			DOM::ElementNode* node = createNode<DOM::ElementNode>();
+			node->tagName = root->store(getTagName(element));
+			node->tagAtom = element.tagAtom;
 
-			for (int i = 0; i < classes.size(); i++)
+			if (options.lazyAttributes)
 			{
-				classList.insert(classes[i]);
+				deferAttributes(tag, *root, *node);
 			}
-			attributes.erase("class");
+			else
+			{
+				parseTagAttributes(tag, *root, *node);
+			}
+
+			currentNode->children.push_back(node);
+			element.node = node;
+			element.parent = currentNode;
+			element.state = OpenElement::State::Ancestor;
+			currentNode = node;
 		}
-		if (attributes.find("id") != attributes.end())
+
+		skippedTags.clear();
+	}
+
+	// Close the open elements from depth up.
+	void DOMBuilder::closeElements(size_t depth)
+	{
+		for (size_t i = depth; i < openElements.size(); i++)
 		{
-			std::vector<std::string> ids;
-			tokenize(attributes["id"], ' ', ids);
+			const OpenElement& element = openElements[i];
+			if (element.tagAtom != unknownAtom)
+			{
+				openCounts[element.tagAtom]--;
+			}
+			else
+			{
+				unknownTagName.assign(getTagName(element));
+				unknownOpenCounts.find(unknownTagName)->second--;
+			}
+		}
 
-			for (int i = 0; i < ids.size(); i++)
+		for (size_t i = depth; i < openElements.size(); i++)
+		{
+			if (openElements[i].state == OpenElement::State::Skipped)
 			{
-				idList.insert(ids[i]);
+				// The skipped elements above are closed too.
+				skippedTags.resize(openElements[i].tagsStart);
+				break;
 			}
-			attributes.erase("id");
 		}
+
+		currentNode = openElements[depth].parent;
+		openElements.erase(openElements.begin() + depth, openElements.end());
+	}
+
+	std::string_view DOMBuilder::getTagName(const OpenElement& element) const
+	{
+		return element.node != nullptr
+			? element.node->tagName
+			: std::string_view(skippedTags).substr(element.tagsStart, element.nameLength);
 	}
 
-	static std::string parseTagClose(const std::string& token)
+	// At most this many unknown names are kept counted across documents.
+	static const size_t maxUnknownTagNamesKept = 1024;
+
+	void DOMBuilder::reset(DOM::RootNode& root)
 	{
-		// Extract tag name.
-		static const regex reTagName("</(.+?)[\\s>]");
+		this->root = &root;
+		currentNode = &root;
+		root.attributeAllowlist = options.attributeAllowlist;
+		openElements.clear();
+		skippedTags.clear();
+		openCounts.fill(0);
+		nodeCount = 0;
 
-		match_results match;
-		if (!regex_search(token.begin(), token.end(), match, reTagName))
+		// The unknown names are kept for the next document, unless there are too many.
+		if (unknownOpenCounts.size() > maxUnknownTagNamesKept)
 		{
-			throw std::logic_error("Failed to apply regex on a tag close token");
+			unknownOpenCounts.clear();
 		}
 
-		std::string tagName = match[1].str();
-		tagName = to_lower(tagName);
-		return tagName;
+		for (auto& [tagName, count] : unknownOpenCounts)
+		{
+			count = 0;
+		}
 	}
 
-	DOM::RootNode buildDOM(const std::vector<Token>& tokens)
+	bool DOMBuilder::append(const Token& token)
 	{
-		DOM::RootNode root;
+		return appendToken(token, nullptr);
+	}
 
-		DOM::NodeWithChildren* currentNode = &root;
-		for (const Token& token : tokens)
+	bool DOMBuilder::append(const Token& token, const TagParts& parts)
+	{
+		return appendToken(token, &parts);
+	}
+
+	bool DOMBuilder::appendToken(const Token& token, const TagParts* parts)
+	{
+		// The lowered name of a close tag, from its parts if extracted.
+		auto getCloseTagName = [&]() -> const std::string& {
+			closeTagName.assign(parts != nullptr && token.type == Token::Type::TagLike
+				? parts->name
+				: parseTagClose(token.content));
+			std::transform(closeTagName.begin(), closeTagName.end(), closeTagName.begin(), toLowerAscii);
+			return closeTagName;
+		};
+
+		// Check if we're inside a raw text element.
+		if (isInRawText())
+		{
+			const OpenElement& element = openElements.back();
+
+			// Inside a raw text element, everything except a matching close tag is text.
+			if (token.type == Token::Type::TagLike
+				&& starts_with(token.content, "</")
+				&& getCloseTagName() == getTagName(element))
+			{
+				// OK, close it.
+				closeElements(openElements.size() - 1);
+			}
+			else if (element.state == OpenElement::State::Selected
+				&& !(options.dropScriptAndStyleText && !isElementOfKind(element.tagAtom, EscapableRawTextElement)))
+			{
+				// Append the token to the TextNode. The lexer gives the whole raw text as one
+				// token, so it's usually just created with it. Nothing else is stored until the
+				// close tag, so the pieces are mostly appended in place.
+				DOM::ElementNode* currentElement = element.node;
+				bool escapable = isElementOfKind(currentElement->tagAtom, EscapableRawTextElement);
+				if (currentElement->children.empty())
+				{
+					currentElement->children.push_back(createNode<DOM::TextNode>(
+						root->store(token.content),
+						escapable && needsDecoding(token.content)));
+				}
+				else
+				{
+					auto* textNode = static_cast<DOM::TextNode*>(currentElement->children[0]);
+					textNode->content = root->storeAppended(textNode->content, token.content);
+					textNode->needsDecoding |= escapable && needsDecoding(token.content);
+				}
+			}
+
+			return true;
+		}
+
+		static const std::string commentStart = "<!--",
+			commentEnd = "-->";
+		switch (token.type)
+		{
+		case Token::Type::TagLike:
 		{
-			// Check if we're inside a raw text element.
-			if (auto* currentElement = dynamic_cast<DOM::ElementNode*>(currentNode))
+			if (starts_with(token.content, commentStart) && ends_with(token.content, commentEnd))
+			{
+				// Comment
+				if (options.dropComments || !isSelecting())
+				{
+					break;
+				}
+
+				currentNode->children.push_back(createNode<DOM::CommentNode>(root->store(token.content.substr(
+					commentStart.length(),
+					token.content.length() - commentStart.length() - commentEnd.length()))));
+			}
+			else
 			{
-				const std::string& tagName = currentElement->tagName;
-				if (std::find(std::begin(rawTextElements),
-					std::end(rawTextElements),
-					tagName) != std::end(rawTextElements))
+				// Tag open or tag close.
+				if (!starts_with(token.content, "</"))
 				{
-					// Inside a raw text element, everything except a matching close tag is text.
-					if (starts_with(token.content, "</") == 0 && parseTagClose(token.content) == tagName)
+					// Tag open.
+					std::string_view attributesString;
+					std::string_view tagName = parts != nullptr ? parts->name : splitTagOpen(token.content, attributesString);
+
+					if (!isSelecting())
+					{
+						if (!isSelected(tagName, parts, attributesString))
+						{
+							skipElement(tagName, token.content);
+							break;
+						}
+
+						if (options.keepAncestors)
+						{
+							keepSkippedAncestors();
+						}
+					}
+
+					DOM::ElementNode* tag = createNode<DOM::ElementNode>();
+					setTagName(*root, *tag, tagName);
+
+					if (options.lazyAttributes)
+					{
+						deferAttributes(token.content, *root, *tag);
+					}
+					else if (parts != nullptr)
+					{
+						setAttributes(*parts, *root, *tag);
+					}
+					else
+					{
+						setAttributes(attributesString, *root, *tag);
+					}
+
+					currentNode->children.push_back(tag);
+
+					if (!isElementOfKind(tag->tagAtom, EmptyElement))
+					{
+						// It's NOT a empty element. Open a new subtree.
+						openElement(tag);
+					}
+				}
+				else
+				{
+					// Tag close.
+					const std::string& tagName = getCloseTagName();
+					Atom tagAtom = findAtom(tagName);
+
+					if (isElementOfKind(tagAtom, EmptyElement))
 					{
-						// OK, close it.
-						currentNode = currentNode->parentNode;
+						// Someone silly is trying to close a empty element. Just ignore it.
 					}
 					else
 					{
-						// Append the token to the TextNode.
-						if (currentElement->children.empty())
+						size_t openCount = openCounts[tagAtom];
+						if (tagAtom == unknownAtom)
 						{
-							currentElement->children.push_back(std::make_shared<DOM::TextNode>(
-								currentNode,
-								""));
+							auto it = unknownOpenCounts.find(tagName);
+							openCount = it != unknownOpenCounts.end() ? it->second : 0;
 						}
 
-						std::string& textContent = std::dynamic_pointer_cast<DOM::TextNode>(
-							currentElement->children[0])
-							->content;
+						if (openCount == 0)
+						{
+							// Someone silly is trying to close a non-exist tag. Just ignore it.
+							return false;
+						}
+
+						// OK. Let's close it, with the elements left open in it -- every one
+						// searched is closed.
+						auto isMatched = [&](const OpenElement& element) {
+							// Only a unknown name has to be compared as a string.
+							return tagAtom != unknownAtom
+								? element.tagAtom == tagAtom
+								: getTagName(element) == tagName;
+						};
 
-						std::string newText = token.content;
-						if (std::find(std::begin(escapableRawTextElements),
-							std::end(escapableRawTextElements),
-							tagName) != std::end(escapableRawTextElements))
+						size_t depth = openElements.size();
+						while (!isMatched(openElements[depth - 1]))
 						{
-							newText = decodeHTMLEntites(newText);
+							depth--;
 						}
 
-						textContent += newText;
+						closeElements(depth - 1);
 					}
-
-					continue;
 				}
 			}
 
-			static const std::string commentStart = "<!--",
-				commentEnd = "-->";
-			switch (token.type)
+			break;
+		}
+		case Token::Type::Text:
+		{
+			// <!DOCTYPE> is lexed to some text -- since we don't support it, just ignore it.
+			// Only the prefix which may match is lowered, instead of a copy of the whole text.
+			static const std::string doctype = "<!DOCTYPE";
+			std::string tokenContent = to_lower(trim(token.content).substr(0, doctype.length()));
+			if (starts_with(tokenContent, doctype) || !isSelecting())
 			{
-			case Token::Type::TagLike:
+				break;
+			}
+
+			std::string_view text = token.content;
+			if (options.whitespaceText != ParseOptions::WhitespaceText::Keep && !text.empty() && std::all_of(text.begin(), text.end(), isSpace))
 			{
-				if (starts_with(token.content, commentStart) && ends_with(token.content, commentEnd))
+				if (options.whitespaceText == ParseOptions::WhitespaceText::Drop)
 				{
-					// Comment
-					currentNode->children.push_back(std::make_shared<DOM::CommentNode>(currentNode, token.content.substr(
-						commentStart.length(),
-						token.content.length() - commentStart.length() - commentEnd.length())));
+					break;
 				}
-				else
+
+				text = " ";
+			}
+
+			// Its entities are decoded only when it's read.
+			currentNode->children.push_back(createNode<DOM::TextNode>(
+				root->store(text),
+				needsDecoding(text)));
+			break;
+		}
+		default:
+			break;
+		}
+
+		return true;
+	}
+
+	void DOMBuilder::adopt(const std::shared_ptr<DOM::RootNode>& root, const DOMBuilder& builder)
+	{
+		for (DOM::Node* child : root->children)
+		{
+			child->parentNode = currentNode;
+			currentNode->children.push_back(child);
+		}
+
+		root->children.clear();
+		this->root->adopt(root);
+		nodeCount += builder.nodeCount;
+
+		// Continue in the elements left open.
+		for (OpenElement element : builder.openElements)
+		{
+			if (element.parent == root.get())
+			{
+				element.parent = currentNode;
+			}
+
+			pushOpenElement(element, builder.getTagName(element));
+		}
+
+		if (!builder.openElements.empty())
+		{
+			currentNode = builder.currentNode;
+		}
+	}
+
+	std::shared_ptr<DOM::RootNode> buildDOM(const std::vector<Token>& tokens, std::pmr::memory_resource* memory, const ParseOptions& options)
+	{
+		auto root = std::make_shared<DOM::RootNode>(memory);
+
+		DOMBuilder builder(*root, options);
+		for (const Token& token : tokens)
+		{
+			builder.append(token);
+		}
+
+		return root;
+	}
+
+	std::shared_ptr<DOM::RootNode> buildDOM(TokenStream tokens, std::pmr::memory_resource* memory, const ParseOptions& options)
+	{
+		auto root = std::make_shared<DOM::RootNode>(memory);
+
+		DOMBuilder builder(*root, options);
+#ifdef USE_REGEX_LEXER
+		for (const Token& token : tokens)
+		{
+			builder.append(token);
+		}
+#else
+		// The tags' parts are extracted while lexing, so their text isn't scanned again.
+		Token token(Token::Type::Text, std::string_view());
+		TagParts parts;
+		while (tokens.next(token, parts))
+		{
+			builder.append(token, parts);
+		}
+#endif
+
+		return root;
+	}
+
+	// The clock and the cancellation of a parse within limits are checked every this many
+	// tokens, a few microseconds apart.
+	static const unsigned tokensBetweenChecks = 256;
+
+	ParseStatus ParseBudget::check(const DOMBuilder& builder)
+	{
+		if (builder.getNodeCount() > limits.maxNodes)
+		{
+			return ParseStatus::TooManyNodes;
+		}
+
+		if (builder.getDepth() > limits.maxDepth)
+		{
+			return ParseStatus::TooDeep;
+		}
+
+		if (tokensUntilCheck-- == 0)
+		{
+			tokensUntilCheck = tokensBetweenChecks - 1;
+
+			if (limits.cancelled != nullptr && limits.cancelled->load(std::memory_order_relaxed))
+			{
+				return ParseStatus::Cancelled;
+			}
+
+			if (limits.deadline && std::chrono::steady_clock::now() >= *limits.deadline)
+			{
+				return ParseStatus::DeadlineExceeded;
+			}
+		}
+
+		return ParseStatus::Complete;
+	}
+
+	ParseStatus buildDOM(DOMBuilder& builder, std::string_view html, const ParseLimits& limits, TagParts& parts)
+	{
+		bool truncated = html.length() > limits.maxInputBytes;
+		if (truncated)
+		{
+			html = html.substr(0, limits.maxInputBytes);
+		}
+
+		ParseBudget budget(limits);
+		ParseStatus status = budget.check(builder);
+
+		TokenStream tokens(html);
+		Token token(Token::Type::Text, std::string_view());
+#ifdef USE_REGEX_LEXER
+		// The regex lexer doesn't extract the parts.
+		(void)parts;
+		while (status == ParseStatus::Complete && tokens.next(token))
+		{
+			builder.append(token);
+			status = budget.check(builder);
+		}
+#else
+		while (status == ParseStatus::Complete && tokens.next(token, parts))
+		{
+			builder.append(token, parts);
+			status = budget.check(builder);
+		}
+#endif
+
+		return status == ParseStatus::Complete && truncated ? ParseStatus::InputTooLarge : status;
+	}
+
+	// Tokens are handed over from the lexer thread in batches of this many, through a queue
+	// of this many batches.
+	static const size_t pipelineBatchSize = 512;
+	static const size_t pipelineQueueCapacity = 8;
+
+	std::shared_ptr<DOM::RootNode> buildDOMPipelined(TokenStream tokens, std::pmr::memory_resource* memory, const ParseOptions& options)
+	{
+		using Batch = std::vector<Token>;
+		SPSCQueue<Batch, pipelineQueueCapacity> queue;
+
+		// Set by the lexer thread when all tokens are pushed, or by this thread to stop it.
+		std::atomic<bool> lexed(false), cancelled(false);
+		std::exception_ptr lexerException;
+
+		std::thread lexer([&]() {
+			Batch batch;
+			auto push = [&]() {
+				while (!queue.tryPush(batch))
 				{
-					// Tag open or tag close.
-					if (!starts_with(token.content, "</"))
+					if (cancelled.load(std::memory_order_relaxed))
 					{
-						// Tag open.
-						std::shared_ptr<DOM::ElementNode> tag = std::make_shared<DOM::ElementNode>(currentNode);
-						parseTagOpen(token.content, tag->tagName, tag->attributes, tag->classList, tag->idList);
+						return false;
+					}
 
-						currentNode->children.push_back(tag);
+					std::this_thread::yield();
+				}
 
-						if (std::find(std::begin(emptyElements),
-							std::end(emptyElements),
-							tag->tagName) == std::end(emptyElements))
-						{
-							// It's NOT a empty element. Open a new subtree.
-							currentNode = tag.get();
-						}
-					}
-					else
+				// Given back the batch consumed before.
+				batch.clear();
+				return true;
+			};
+
+			try
+			{
+				batch.reserve(pipelineBatchSize);
+				for (const Token& token : tokens)
+				{
+					batch.push_back(token);
+					if (batch.size() == pipelineBatchSize && !push())
 					{
-						// Tag close.
-						std::string tagName = parseTagClose(token.content);
+						return;
+					}
+				}
 
-						if (std::find(std::begin(emptyElements),
-							std::end(emptyElements),
-							tagName) != std::end(emptyElements))
-						{
-							// Someone silly is trying to close a empty element. Just ignore it.
-						}
-						else
-						{
-							// OK. Let's close it.
-
-							DOM::NodeWithChildren* originalCurrentNode = currentNode;
-							DOM::ElementNode* currentElement;
-							while ((currentElement = dynamic_cast<DOM::ElementNode*>(currentNode)) != nullptr // The node IS a element
-								&& currentElement->tagName != tagName)
-							{ // and tag name is not matched.
-								// Close current node and continue to check tag name if tag name is NOT matched.
-								currentNode = currentNode->parentNode;
-							}
-
-							if (currentElement == nullptr)
-							{
-								// Someone silly is trying to close a non-exist tag. Just ignore it and go back.
-								currentNode = originalCurrentNode;
-							}
-							else
-							{
-								// Close current element's node.
-								currentNode = currentNode->parentNode;
-							}
-						}
+				if (!batch.empty())
+				{
+					push();
+				}
+			}
+			catch (...)
+			{
+				lexerException = std::current_exception();
+			}
+
+			lexed.store(true, std::memory_order_release);
+		});
+
+		auto root = std::make_shared<DOM::RootNode>(memory);
+		DOMBuilder builder(*root, options);
+
+		try
+		{
+			Batch batch;
+			for (;;)
+			{
+				// Checked before popping, so if it's done, nothing is left once the queue is empty.
+				bool done = lexed.load(std::memory_order_acquire);
+
+				if (queue.tryPop(batch))
+				{
+					for (const Token& token : batch)
+					{
+						builder.append(token);
 					}
 				}
+				else if (done)
+				{
+					break;
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+		catch (...)
+		{
+			cancelled.store(true, std::memory_order_relaxed);
+			lexer.join();
+			throw;
+		}
 
-				break;
+		lexer.join();
+
+		if (lexerException)
+		{
+			std::rethrow_exception(lexerException);
+		}
+
+		return root;
+	}
+
+	// A document is only built in parallel with at least this many tokens for each thread.
+	static const size_t minimumChunkSize = 16 * 1024;
+
+	std::shared_ptr<DOM::RootNode> buildDOMParallel(const std::vector<Token>& tokens, unsigned threadCount, std::pmr::memory_resource* memory, const ParseOptions& options)
+	{
+		size_t chunkCount = std::min<size_t>(threadCount, tokens.size() / minimumChunkSize);
+		if (chunkCount <= 1 || !options.keepSubtrees.empty())
+		{
+			// Whether a chunk's elements are kept depends on the elements open before it.
+			return buildDOM(tokens, memory, options);
+		}
+
+		auto getChunkStart = [&](size_t i) {
+			return tokens.size() * i / chunkCount;
+		};
+
+		// A part of a chunk, tokens [start, end), built from an empty root with its own arena.
+		struct Piece
+		{
+			std::shared_ptr<DOM::RootNode> root;
+			DOMBuilder builder;
+			size_t start, end;
+
+			Piece(size_t start, std::pmr::memory_resource* memory, const ParseOptions& options)
+				: root(std::make_shared<DOM::RootNode>(memory)), builder(*root, options), start(start), end(start) {}
+		};
+
+		// Every chunk but the first is built speculatively. A close tag matching nothing in a
+		// piece likely closes an element opened before the chunk, so a new piece starts after
+		// it -- as if everything before is closed.
+		std::vector<std::deque<Piece>> chunks(chunkCount);
+		auto buildChunk = [&](size_t i) {
+			std::deque<Piece>& pieces = chunks[i];
+			size_t start = getChunkStart(i), end = getChunkStart(i + 1);
+
+			try
+			{
+				pieces.emplace_back(start, memory, options);
+				for (size_t j = start; j < end; j++)
+				{
+					if (!pieces.back().builder.append(tokens[j]))
+					{
+						pieces.emplace_back(j + 1, memory, options);
+					}
+
+					pieces.back().end = j + 1;
+				}
+			}
+			catch (...)
+			{
+				// The tokens may not throw at all in their real context. Leave them to be
+				// built again.
+				pieces.clear();
 			}
-			case Token::Type::Text:
+		};
+
+		auto root = std::make_shared<DOM::RootNode>(memory);
+		DOMBuilder builder(*root, options);
+
+		std::vector<std::future<void>> futures;
+		for (size_t i = 1; i < chunkCount; i++)
+		{
+			futures.push_back(std::async(std::launch::async, buildChunk, i));
+		}
+
+		for (size_t i = 0; i < getChunkStart(1); i++)
+		{
+			builder.append(tokens[i]);
+		}
+
+		for (size_t i = 1; i < chunkCount; i++)
+		{
+			futures[i - 1].get();
+
+			// Graft the pieces while the guesses hold, and build the rest again.
+			size_t next = getChunkStart(i), end = getChunkStart(i + 1);
+			for (Piece& piece : chunks[i])
 			{
-				// <!DOCTYPE> is lexed to some text -- since we don't support it, just ignore it.
-				std::string tokenContent = trim(token.content);
-				tokenContent = to_lower(tokenContent);
-				if (starts_with(tokenContent, "<!DOCTYPE"))
+				if (next < piece.start && !builder.append(tokens[next++]))
 				{
+					// The close tag before the piece closes nothing after all.
 					break;
 				}
 
-				currentNode->children.push_back(std::make_shared<DOM::TextNode>(
-					currentNode,
-					decodeHTMLEntites(token.content)));
-				break;
+				if (builder.isInRawText())
+				{
+					break;
+				}
+
+				builder.adopt(piece.root, piece.builder);
+				next = piece.end;
 			}
-			default:
-				break;
+
+			for (; next < end; next++)
+			{
+				builder.append(tokens[next]);
 			}
 		}
 
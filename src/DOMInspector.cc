@@ -4,7 +4,7 @@
 #include "TerminalColor.h"
 
 namespace html_parser {
-	std::string inspect(std::string data)
+	std::string inspect(std::string_view data)
 	{
 		std::string result;
 		for (char ch : data)
@@ -48,34 +48,35 @@ namespace html_parser {
 		return '"' + result + '"';
 	}
 
-	void inspectNode(const DOM::Node* node, size_t indentLevel)
+	// Print a node by itself, without its children.
+	static void printNode(const DOM::Node* node, size_t indentLevel)
 	{
 		auto indent = [indentLevel](int add = 0) -> std::string
 			{
 				return std::string(indentLevel * 4 + add, ' ');
 			};
 
-		if (auto rootNode = dynamic_cast<const DOM::RootNode*>(node))
+		switch (node->type)
 		{
-			(void)rootNode; // Disable GCC -Wunused-variable.
+		case DOM::Node::Type::Root:
 			std::cout << indent()
 				<< TerminalColor::Bold << TerminalColor::ForegroundYellow
 				<< "DOM::RootNode"
 				<< TerminalColor::Reset
 				<< std::endl;
-		}
-		else if (auto textNode = dynamic_cast<const DOM::TextNode*>(node))
-		{
+			break;
+		case DOM::Node::Type::Text:
 			std::cout << indent()
 				<< TerminalColor::Bold << TerminalColor::ForegroundBlue
 				<< "DOM::TextNode "
 				<< TerminalColor::Reset << TerminalColor::ForegroundGreen
-				<< inspect(textNode->content)
+				<< inspect(static_cast<const DOM::TextNode*>(node)->getText())
 				<< TerminalColor::Reset
 				<< std::endl;
-		}
-		else if (auto elementNode = dynamic_cast<const DOM::ElementNode*>(node))
+			break;
+		case DOM::Node::Type::Element:
 		{
+			auto elementNode = static_cast<const DOM::ElementNode*>(node);
 			std::cout << indent()
 				<< TerminalColor::Bold << TerminalColor::ForegroundCyan
 				<< "DOM::ElementNode"
@@ -86,40 +87,47 @@ namespace html_parser {
 				<< TerminalColor::Reset
 				<< ')'
 				<< std::endl;
-			for (const std::pair<std::string, std::string>& attribute : elementNode->attributes)
+			for (const auto& attribute : elementNode->getAttributes())
 			{
 				std::cout << indent(1)
 					<< '['
 					<< TerminalColor::ForegroundYellow
 					<< "Attribute "
 					<< TerminalColor::Reset << TerminalColor::Bold
-					<< inspect(attribute.first)
+					<< inspect(attribute.name)
 					<< TerminalColor::Reset
 					<< " = "
 					<< TerminalColor::ForegroundMagenta
-					<< inspect(attribute.second)
+					<< inspect(attribute.value)
 					<< TerminalColor::Reset
 					<< ']'
 					<< std::endl;
 			}
+			break;
 		}
-		else if (auto commentNode = dynamic_cast<const DOM::CommentNode*>(node))
-		{
+		case DOM::Node::Type::Comment:
 			std::cout << indent()
 				<< TerminalColor::Bold << TerminalColor::ForegroundMagenta
 				<< "DOM::CommentNode "
 				<< TerminalColor::Reset << TerminalColor::ForegroundGreen
-				<< inspect(commentNode->content)
+				<< inspect(static_cast<const DOM::CommentNode*>(node)->content)
 				<< TerminalColor::Reset
 				<< std::endl;
+			break;
 		}
 
-		if (auto nodeWithChildren = dynamic_cast<const DOM::NodeWithChildren*>(node))
+	}
+
+	void inspectNode(const DOM::Node* node, size_t indentLevel)
+	{
+		printNode(node, indentLevel);
+
+		if (node->hasChildren())
 		{
-			for (const std::shared_ptr<DOM::Node>& childNode : nodeWithChildren->children)
-			{
-				inspectNode(childNode.get(), indentLevel + 1);
-			}
+			DOM::forEachInSubtree(static_cast<const DOM::NodeWithChildren*>(node), [&](const DOM::Node* childNode, size_t depth) {
+				printNode(childNode, indentLevel + depth);
+				return true;
+			});
 		}
 	}
 }
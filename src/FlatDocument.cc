@@ -0,0 +1,313 @@
+#include "FlatDocument.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "macros.h"
+
+namespace html_parser {
+	FlatDocument::Span FlatDocument::addString(std::string_view string)
+	{
+		if (string.length() > UINT32_MAX - strings.length())
+		{
+			throw std::length_error("Document too large to flatten");
+		}
+
+		Span span{ (uint32_t)strings.length(), (uint32_t)string.length() };
+		strings += string;
+		return span;
+	}
+
+	FlatDocument::Range FlatDocument::addList(const std::pmr::vector<std::string_view>& list, std::vector<Span>& spans)
+	{
+		Range range{ (uint32_t)spans.size(), (uint32_t)list.size() };
+		for (std::string_view item : list)
+		{
+			spans.push_back(addString(item));
+		}
+		return range;
+	}
+
+	FlatDocument::Index FlatDocument::addNode(const DOM::Node* node, Index parent)
+	{
+		if (types.size() == none)
+		{
+			throw std::length_error("Document too large to flatten");
+		}
+
+		Index index = (Index)types.size();
+		types.push_back(node->type);
+		tagAtoms.push_back(unknownAtom);
+		parents.push_back(parent);
+		firstChildren.push_back(none);
+		nextSiblings.push_back(none);
+		subtreeEnds.push_back(none);
+		texts.push_back(Span{ 0, 0 });
+		attributeRanges.push_back(Range{ 0, 0 });
+		classRanges.push_back(Range{ 0, 0 });
+		idRanges.push_back(Range{ 0, 0 });
+
+		switch (node->type)
+		{
+		case DOM::Node::Type::Element:
+		{
+			auto* element = static_cast<const DOM::ElementNode*>(node);
+			tagAtoms[index] = element->tagAtom;
+			texts[index] = addString(element->tagName);
+
+			attributeRanges[index] = Range{ (uint32_t)attributes.size(), (uint32_t)element->getAttributes().size() };
+			for (const DOM::Attribute& attribute : element->getAttributes())
+			{
+				Span name = addString(attribute.name);
+				attributes.push_back(Attribute{ name, addString(attribute.value) });
+			}
+
+			classRanges[index] = addList(element->getClassList(), classes);
+			idRanges[index] = addList(element->getIdList(), ids);
+			break;
+		}
+		case DOM::Node::Type::Text:
+			texts[index] = addString(static_cast<const DOM::TextNode*>(node)->getText());
+			break;
+		case DOM::Node::Type::Comment:
+			texts[index] = addString(static_cast<const DOM::CommentNode*>(node)->content);
+			break;
+		default:
+			break;
+		}
+
+		return index;
+	}
+
+	FlatDocument::FlatDocument(const DOM::NodeWithChildren& tree)
+	{
+		// The nodes whose subtrees are being added, from the root, and the last child added
+		// to each.
+		std::vector<Index> path, lastChildren;
+		auto endSubtrees = [&](size_t depth) {
+			while (path.size() > depth)
+			{
+				subtreeEnds[path.back()] = (Index)types.size();
+				path.pop_back();
+				lastChildren.pop_back();
+			}
+		};
+
+		path.push_back(addNode(&tree, none));
+		lastChildren.push_back(none);
+
+		DOM::forEachInSubtree(&tree, [&](const DOM::Node* node, size_t depth) {
+			endSubtrees(depth);
+
+			Index index = addNode(node, path.back());
+			if (lastChildren.back() == none)
+			{
+				firstChildren[path.back()] = index;
+			}
+			else
+			{
+				nextSiblings[lastChildren.back()] = index;
+			}
+			lastChildren.back() = index;
+
+			if (node->hasChildren())
+			{
+				path.push_back(index);
+				lastChildren.push_back(none);
+			}
+			else
+			{
+				subtreeEnds[index] = index + 1;
+			}
+
+			return true;
+		});
+
+		endSubtrees(0);
+
+		// Nothing is added anymore, so give back what the vectors have grown too much.
+		types.shrink_to_fit();
+		tagAtoms.shrink_to_fit();
+		parents.shrink_to_fit();
+		firstChildren.shrink_to_fit();
+		nextSiblings.shrink_to_fit();
+		subtreeEnds.shrink_to_fit();
+		texts.shrink_to_fit();
+		attributeRanges.shrink_to_fit();
+		classRanges.shrink_to_fit();
+		idRanges.shrink_to_fit();
+		attributes.shrink_to_fit();
+		classes.shrink_to_fit();
+		ids.shrink_to_fit();
+		strings.shrink_to_fit();
+	}
+
+	bool FlatDocument::listContains(const std::vector<Span>& spans, Range range, std::string_view item) const
+	{
+		auto begin = spans.begin() + range.start, end = begin + range.count;
+		auto it = std::lower_bound(begin, end, item, [&](Span span, std::string_view item) {
+			return getString(span) < item;
+		});
+		return it != end && getString(*it) == item;
+	}
+
+	std::unordered_set<std::string> FlatDocument::copyList(const std::vector<Span>& spans, Range range) const
+	{
+		std::unordered_set<std::string> result;
+		for (uint32_t i = range.start; i < range.start + range.count; i++)
+		{
+			result.emplace(getString(spans[i]));
+		}
+		return result;
+	}
+
+	std::string FlatDocument::getTextContent(Index node) const
+	{
+		std::string result;
+		for (Index i = node + 1; i < subtreeEnds[node]; i++)
+		{
+			if (types[i] == DOM::Node::Type::Text)
+			{
+				result += getString(texts[i]);
+			}
+		}
+		return result;
+	}
+
+	std::string FlatDocument::getDirectTextContent(Index node) const
+	{
+		std::string result;
+		for (Index child = firstChildren[node]; child != none; child = nextSiblings[child])
+		{
+			if (types[child] == DOM::Node::Type::Text)
+			{
+				result += getString(texts[child]);
+			}
+		}
+		return result;
+	}
+
+	std::string_view FlatDocument::getAttribute(Index node, const std::string& name) const
+	{
+		std::string lowerName = to_lower(name);
+
+		Range range = attributeRanges[node];
+		for (uint32_t i = range.start; i < range.start + range.count; i++)
+		{
+			if (getString(attributes[i].name) == lowerName)
+			{
+				return getString(attributes[i].value);
+			}
+		}
+		return std::string_view();
+	}
+
+	std::unordered_set<std::string> FlatDocument::getClassList(Index node) const
+	{
+		return copyList(classes, classRanges[node]);
+	}
+
+	std::unordered_set<std::string> FlatDocument::getIdList(Index node) const
+	{
+		return copyList(ids, idRanges[node]);
+	}
+
+	FlatDocument::Index FlatDocument::getElementById(const std::string& id, Index node) const
+	{
+		if (id.empty())
+		{
+			throw std::logic_error("Empty string passed to getElementById()");
+		}
+
+		for (Index i = node + 1; i < subtreeEnds[node]; i++)
+		{
+			if (listContains(ids, idRanges[i], id))
+			{
+				return i;
+			}
+		}
+		return none;
+	}
+
+	std::vector<FlatDocument::Index> FlatDocument::getElementsByName(const std::string& name, Index node) const
+	{
+		if (name.empty())
+		{
+			throw std::logic_error("Empty string passed to getElementsByName()");
+		}
+
+		std::vector<Index> result;
+		for (Index i = node + 1; i < subtreeEnds[node]; i++)
+		{
+			if (types[i] == DOM::Node::Type::Element && getAttribute(i, "name") == name)
+			{
+				result.push_back(i);
+			}
+		}
+		return result;
+	}
+
+	std::vector<FlatDocument::Index> FlatDocument::getElementsByTagName(const std::string& tagName, Index node) const
+	{
+		if (tagName.empty())
+		{
+			throw std::logic_error("Empty string passed to getElementsByTagName()");
+		}
+
+		std::vector<Index> result;
+		Atom tagAtom = findAtom(tagName);
+		if (tagAtom != unknownAtom)
+		{
+			for (Index i = node + 1; i < subtreeEnds[node]; i++)
+			{
+				if (tagAtoms[i] == tagAtom)
+				{
+					result.push_back(i);
+				}
+			}
+		}
+		else
+		{
+			// Only a unknown name has to be compared as a string.
+			for (Index i = node + 1; i < subtreeEnds[node]; i++)
+			{
+				if (types[i] == DOM::Node::Type::Element && tagAtoms[i] == unknownAtom && getString(texts[i]) == tagName)
+				{
+					result.push_back(i);
+				}
+			}
+		}
+		return result;
+	}
+
+	std::vector<FlatDocument::Index> FlatDocument::getElementsByClassName(const std::string& className, Index node) const
+	{
+		if (className.empty())
+		{
+			throw std::logic_error("Empty string passed to getElementsByClassName()");
+		}
+
+		std::vector<Index> result;
+		for (Index i = node + 1; i < subtreeEnds[node]; i++)
+		{
+			if (listContains(classes, classRanges[i], className))
+			{
+				result.push_back(i);
+			}
+		}
+		return result;
+	}
+
+	std::vector<FlatDocument::Index> FlatDocument::getChildren(Index node) const
+	{
+		std::vector<Index> result;
+		for (Index child = firstChildren[node]; child != none; child = nextSiblings[child])
+		{
+			if (types[child] == DOM::Node::Type::Element)
+			{
+				result.push_back(child);
+			}
+		}
+		return result;
+	}
+}
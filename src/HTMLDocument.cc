@@ -1,35 +1,100 @@
 #include "HTMLDocument.h"
 
+#include <algorithm>
 #include <exception>
+#include <thread>
+
+#include "IncrementalParser.h"
+#include "InputFile.h"
 
 namespace html_parser {
-	HTMLDocument::Element HTMLDocument::internelGetElementById(const DOM::NodeWithChildren* node, const std::string& id)
+	// Size of the chunks in which a document not in memory is read and parsed.
+	static const size_t chunkSize = 64 * 1024;
+
+	void HTMLDocument::parse(std::istream& is)
+	{
+		IncrementalParser parser(memory, options);
+		std::vector<char> chunk(chunkSize);
+		while (is.read(chunk.data(), chunkSize) || is.gcount() > 0)
+		{
+			parser.feed(std::string_view(chunk.data(), (size_t)is.gcount()));
+		}
+
+		*this = parser.finish();
+	}
+
+	ParseStatus HTMLDocument::parse(const std::string& html, const ParseLimits& limits)
+	{
+		auto root = std::make_shared<DOM::RootNode>(memory);
+		DOMBuilder builder(*root, options);
+		TagParts parts;
+		ParseStatus status = buildDOM(builder, html, limits, parts);
+
+		domRoot = root;
+		return status;
+	}
+
+	void HTMLDocument::parseParallel(const std::string& html, unsigned threadCount)
+	{
+		if (threadCount == 0)
+		{
+			threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		domRoot = buildDOMParallel(getTokensParallel(html, threadCount), threadCount, memory, options);
+	}
+
+	HTMLDocument HTMLDocument::fromFile(const std::string& path, std::pmr::memory_resource* memory, const ParseOptions& options)
+	{
+		InputFile file(path);
+		if (file.isMapped())
+		{
+			// The DOM tree copies what it needs from the tokens, so it outlives the mapping.
+			HTMLDocument document(memory, options);
+			document.domRoot = buildDOM(TokenStream(file.getContents()), memory, options);
+			return document;
+		}
+
+		IncrementalParser parser(memory, options);
+		std::vector<char> chunk(chunkSize);
+		while (size_t size = file.read(chunk.data(), chunkSize))
+		{
+			parser.feed(std::string_view(chunk.data(), size));
+		}
+
+		return parser.finish();
+	}
+
+	HTMLDocument::Element HTMLDocument::internelGetElementById(const std::shared_ptr<DOM::NodeWithChildren>& tree,
+		const DOM::NodeWithChildren* node, const std::string& id)
 	{
 		if (id.empty())
 		{
 			throw std::logic_error("Empty string passed to getElementById()");
 		}
 
-		for (const std::shared_ptr<DOM::Node>& child : node->children)
-		{
-			if (auto childElement = std::dynamic_pointer_cast<DOM::ElementNode>(child))
+		DOM::ElementNode* found = nullptr;
+		DOM::forEachInSubtree(node, [&](DOM::Node* child, size_t) {
+			if (child->type == DOM::Node::Type::Element
+				&& DOM::ElementNode::listContains(static_cast<DOM::ElementNode*>(child)->getIdList(), id))
 			{
-				if (childElement->idList.find(id) != childElement->idList.end())
-				{
-					return HTMLDocument::Element(childElement);
-				}
-
-				if (HTMLDocument::Element element = HTMLDocument::internelGetElementById(childElement.get(), id))
-				{
-					return element;
-				}
+				found = static_cast<DOM::ElementNode*>(child);
+				return false;
 			}
+
+			return true;
+		});
+
+		if (found == nullptr)
+		{
+			return HTMLDocument::Element();
 		}
 
-		return HTMLDocument::Element();
+		return HTMLDocument::Element(std::shared_ptr<DOM::ElementNode>(tree, found));
 	}
 
-	void HTMLDocument::internelGetElementsByName(const DOM::NodeWithChildren* node,
+	void HTMLDocument::internelGetElementsByName(const std::shared_ptr<DOM::NodeWithChildren>& tree,
+		const DOM::NodeWithChildren* node,
 		const std::string& name,
 		std::vector<HTMLDocument::Element>& result)
 	{
@@ -38,22 +103,24 @@ namespace html_parser {
 			throw std::logic_error("Empty string passed to getElementsByName()");
 		}
 
-		for (const std::shared_ptr<DOM::Node>& child : node->children)
-		{
-			if (auto childElement = std::dynamic_pointer_cast<DOM::ElementNode>(child))
+		DOM::forEachInSubtree(node, [&](DOM::Node* child, size_t) {
+			if (child->type == DOM::Node::Type::Element)
 			{
-				if (HTMLDocument::internelGetAttribute(childElement.get(), "name") == name)
+				auto* childElement = static_cast<DOM::ElementNode*>(child);
+				if (HTMLDocument::internelGetAttribute(childElement, "name") == name)
 				{
-					result.push_back(HTMLDocument::Element(childElement));
+					result.push_back(HTMLDocument::Element(std::shared_ptr<DOM::ElementNode>(tree, childElement)));
 				}
-
-				HTMLDocument::internelGetElementsByName(childElement.get(), name, result);
 			}
-		}
+
+			return true;
+		});
 	}
 
-	void HTMLDocument::internelGetElementsByTagName(const DOM::NodeWithChildren* node,
+	void HTMLDocument::internelGetElementsByTagName(const std::shared_ptr<DOM::NodeWithChildren>& tree,
+		const DOM::NodeWithChildren* node,
 		const std::string& tagName,
+		Atom tagAtom,
 		std::vector<HTMLDocument::Element>& result)
 	{
 		if (tagName.empty())
@@ -61,21 +128,25 @@ namespace html_parser {
 			throw std::logic_error("Empty string passed to getElementsByTagName()");
 		}
 
-		for (const std::shared_ptr<DOM::Node>& child : node->children)
-		{
-			if (auto childElement = std::dynamic_pointer_cast<DOM::ElementNode>(child))
+		DOM::forEachInSubtree(node, [&](DOM::Node* child, size_t) {
+			if (child->type == DOM::Node::Type::Element)
 			{
-				if (childElement->tagName == tagName)
+				auto* childElement = static_cast<DOM::ElementNode*>(child);
+				// Only a unknown name has to be compared as a string.
+				if (tagAtom != unknownAtom
+					? childElement->tagAtom == tagAtom
+					: std::string_view(childElement->tagName) == tagName)
 				{
-					result.push_back(HTMLDocument::Element(childElement));
+					result.push_back(HTMLDocument::Element(std::shared_ptr<DOM::ElementNode>(tree, childElement)));
 				}
-
-				HTMLDocument::internelGetElementsByTagName(childElement.get(), tagName, result);
 			}
-		}
+
+			return true;
+		});
 	}
 
-	void HTMLDocument::internelGetElementsByClassName(const DOM::NodeWithChildren* node,
+	void HTMLDocument::internelGetElementsByClassName(const std::shared_ptr<DOM::NodeWithChildren>& tree,
+		const DOM::NodeWithChildren* node,
 		const std::string& className,
 		std::vector<HTMLDocument::Element>& result)
 	{
@@ -84,63 +155,71 @@ namespace html_parser {
 			throw std::logic_error("Empty string passed to getElementsByName()");
 		}
 
-		for (const std::shared_ptr<DOM::Node>& child : node->children)
-		{
-			if (auto childElement = std::dynamic_pointer_cast<DOM::ElementNode>(child))
+		DOM::forEachInSubtree(node, [&](DOM::Node* child, size_t) {
+			if (child->type == DOM::Node::Type::Element)
 			{
-				if (childElement->classList.find(className) != childElement->classList.end())
+				auto* childElement = static_cast<DOM::ElementNode*>(child);
+				if (DOM::ElementNode::listContains(childElement->getClassList(), className))
 				{
-					result.push_back(HTMLDocument::Element(childElement));
+					result.push_back(HTMLDocument::Element(std::shared_ptr<DOM::ElementNode>(tree, childElement)));
 				}
-
-				HTMLDocument::internelGetElementsByClassName(childElement.get(), className, result);
 			}
-		}
+
+			return true;
+		});
 	}
 
-	void HTMLDocument::internelGetChildren(const DOM::NodeWithChildren* node, std::vector<Element>& result)
+	void HTMLDocument::internelGetChildren(const std::shared_ptr<DOM::NodeWithChildren>& tree,
+		const DOM::NodeWithChildren* node, std::vector<Element>& result)
 	{
-		for (const std::shared_ptr<DOM::Node>& child : node->children)
+		for (DOM::Node* child : node->children)
 		{
-			if (auto childElement = std::dynamic_pointer_cast<DOM::ElementNode>(child))
+			if (child->type == DOM::Node::Type::Element)
 			{
-				result.push_back(HTMLDocument::Element(childElement));
+				auto* childElement = static_cast<DOM::ElementNode*>(child);
+				result.push_back(HTMLDocument::Element(std::shared_ptr<DOM::ElementNode>(tree, childElement)));
 			}
 		}
 	}
 
 	void HTMLDocument::internelGetTextContent(const DOM::NodeWithChildren* node, std::string& result)
 	{
-		for (const std::shared_ptr<DOM::Node>& child : node->children)
-		{
-			if (auto childElement = std::dynamic_pointer_cast<DOM::ElementNode>(child))
-			{
-				HTMLDocument::internelGetTextContent(childElement.get(), result);
-			}
-			else if (auto childTextNode = std::dynamic_pointer_cast<DOM::TextNode>(child))
+		DOM::forEachInSubtree(node, [&](DOM::Node* child, size_t) {
+			if (child->type == DOM::Node::Type::Text)
 			{
-				result += childTextNode->content;
+				static_cast<DOM::TextNode*>(child)->appendText(result);
 			}
-		}
+
+			return true;
+		});
 	}
 
 	void HTMLDocument::internelGetDirectTextContent(const DOM::NodeWithChildren* node, std::string& result)
 	{
-		for (const std::shared_ptr<DOM::Node>& child : node->children)
+		for (DOM::Node* child : node->children)
 		{
-			if (auto childTextNode = std::dynamic_pointer_cast<DOM::TextNode>(child))
+			if (child->type == DOM::Node::Type::Text)
 			{
-				result += childTextNode->content;
+				static_cast<DOM::TextNode*>(child)->appendText(result);
 			}
 		}
 	}
 
 	std::string HTMLDocument::internelGetAttribute(const DOM::ElementNode* node, const std::string& name)
 	{
-		std::string clonedName = to_lower(name);
-		std::unordered_map<std::string, std::string>::const_iterator it = node->attributes.find(clonedName);
-		if (it == node->attributes.end())
+		const std::string_view* value = node->findAttribute(to_lower(name));
+		if (value == nullptr)
 			return "";
-		return it->second;
+		return std::string(*value);
+	}
+
+	std::unordered_set<std::string> HTMLDocument::copyStringSet(const std::pmr::vector<std::string_view>& list)
+	{
+		std::unordered_set<std::string> result;
+		for (std::string_view item : list)
+		{
+			result.emplace(item);
+		}
+		return result;
 	}
 }
@@ -2,6 +2,8 @@
 
 #include <limits>
 
+#include "Scanner.h"
+
 namespace html_parser {
 	// From https://bitbucket.org/cggaertner/cstuff/src/master/entities.c.
 	static const char* const namedEntities[][2] = {
@@ -265,11 +267,9 @@ namespace html_parser {
 		std::string word;
 	};
 
-	static std::shared_ptr<TrieNode> namedEntitiesTrieRoot;
-
-	static void initializeNamedEntitesTrie()
+	static std::shared_ptr<TrieNode> buildNamedEntitiesTrie()
 	{
-		namedEntitiesTrieRoot = std::make_shared<TrieNode>();
+		std::shared_ptr<TrieNode> namedEntitiesTrieRoot = std::make_shared<TrieNode>();
 
 		using EntitiePair = const char* const [2];
 		for (EntitiePair& pair : namedEntities)
@@ -287,17 +287,27 @@ namespace html_parser {
 
 			(*current)->word = pair[1];
 		}
+
+		return namedEntitiesTrieRoot;
 	}
 
-	static std::string parseNamedEntity(std::string::const_iterator& begin,
-		std::string::const_iterator end)
+	// Built on first use. Texts are decoded when they're read, maybe on several threads at
+	// once, so it's a static local, initialized once even then.
+	static const std::shared_ptr<TrieNode>& getNamedEntitiesTrie()
 	{
-		std::string::const_iterator backupBegin = begin;
+		static const std::shared_ptr<TrieNode> namedEntitiesTrieRoot = buildNamedEntitiesTrie();
+		return namedEntitiesTrieRoot;
+	}
 
-		std::shared_ptr<TrieNode> current = namedEntitiesTrieRoot;
-		for (std::string::const_iterator& it = begin; current && current->word.empty() && it != end; it++)
+	static std::string parseNamedEntity(std::string_view::const_iterator& begin,
+		std::string_view::const_iterator end)
+	{
+		std::string_view::const_iterator backupBegin = begin;
+
+		const TrieNode* current = getNamedEntitiesTrie().get();
+		for (std::string_view::const_iterator& it = begin; current && current->word.empty() && it != end; it++)
 		{
-			current = current->child[(unsigned char)*it];
+			current = current->child[(unsigned char)*it].get();
 		}
 
 		if (current && !current->word.empty())
@@ -307,27 +317,40 @@ namespace html_parser {
 		return "";
 	}
 
-	std::string decodeHTMLEntites(const std::string& text)
+	void decodeHTMLEntites(std::string_view text, std::string& result)
 	{
-		if (!namedEntitiesTrieRoot)
-			initializeNamedEntitesTrie();
+		static constexpr DelimiterSet entityDelimiters("&");
 
-		std::string result;
-		for (std::string::const_iterator it = text.begin(); it != text.end();)
+		for (std::string_view::const_iterator it = text.begin(); it != text.end();)
 		{
-			if (*it == '&')
+			// Copy the run of text before the next '&' at once.
+			const char* runBegin = text.data() + (it - text.begin());
+			const char* runEnd = findDelimiter(runBegin, text.data() + text.length(), entityDelimiters);
+			result.append(runBegin, runEnd);
+			it += runEnd - runBegin;
+
+			if (it == text.end())
+				break;
+
+			// The names in the trie don't start with the '&'.
+			std::string_view::const_iterator entityBegin = it + 1;
+			std::string decoded = parseNamedEntity(entityBegin, text.end());
+			if (!decoded.empty())
 			{
-				std::string decoded = parseNamedEntity(it, text.end());
-				if (!decoded.empty())
-				{
-					result.append(decoded);
-					continue;
-				}
+				result.append(decoded);
+				it = entityBegin;
+				continue;
 			}
 
 			result.append(1, *it++);
 		}
+	}
 
+	std::string decodeHTMLEntites(std::string_view text)
+	{
+		std::string result;
+		result.reserve(text.length());
+		decodeHTMLEntites(text, result);
 		return result;
 	}
 }
@@ -0,0 +1,140 @@
+#include "HTMLParser.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace html_parser {
+	// Size of the chunks in which a stream is read and parsed.
+	static const size_t chunkSize = 64 * 1024;
+
+	void* HTMLParser::BlockCache::do_allocate(size_t size, size_t alignment)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (size_t i = blocks.size(); i > 0; i--)
+			{
+				if (blocks[i - 1].size == size && blocks[i - 1].alignment == alignment)
+				{
+					void* pointer = blocks[i - 1].pointer;
+					blocks[i - 1] = blocks.back();
+					blocks.pop_back();
+					return pointer;
+				}
+			}
+		}
+
+		return upstream->allocate(size, alignment);
+	}
+
+	void HTMLParser::BlockCache::do_deallocate(void* pointer, size_t size, size_t alignment)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		blocks.push_back(Block{ pointer, size, alignment });
+	}
+
+	bool HTMLParser::BlockCache::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+	{
+		return this == &other;
+	}
+
+	HTMLParser::BlockCache::~BlockCache()
+	{
+		for (const Block& block : blocks)
+		{
+			upstream->deallocate(block.pointer, block.size, block.alignment);
+		}
+	}
+
+	HTMLParser::HTMLParser(std::pmr::memory_resource* memory, const ParseOptions& options)
+		: memory(memory), options(options), chunk(chunkSize) {}
+
+	// The root and its control block are allocated from the cache too.
+	std::shared_ptr<DOM::RootNode> HTMLParser::createRoot()
+	{
+		auto root = std::allocate_shared<DOM::RootNode>(std::pmr::polymorphic_allocator<DOM::RootNode>(&memory), &memory);
+		if (builder)
+		{
+			builder->reset(*root);
+		}
+		else
+		{
+			builder.emplace(*root, options);
+		}
+
+		return root;
+	}
+
+	HTMLDocument HTMLParser::parse(std::string_view html)
+	{
+		ParseStatus status;
+		return parse(html, ParseLimits(), status);
+	}
+
+	HTMLDocument HTMLParser::parse(std::istream& is)
+	{
+		ParseStatus status;
+		return parse(is, ParseLimits(), status);
+	}
+
+	HTMLDocument HTMLParser::parse(std::string_view html, const ParseLimits& limits, ParseStatus& status)
+	{
+		auto root = createRoot();
+		status = buildDOM(*builder, html, limits, parts);
+
+		return HTMLDocument(&memory, options, std::move(root));
+	}
+
+	HTMLDocument HTMLParser::parse(std::istream& is, const ParseLimits& limits, ParseStatus& status)
+	{
+		auto root = createRoot();
+
+		ParseBudget budget(limits);
+		status = budget.check(*builder);
+
+		auto buildTokens = [&]() {
+			for (const Token& token : tokens)
+			{
+				if (status != ParseStatus::Complete)
+				{
+					break;
+				}
+
+				builder->append(token);
+				status = budget.check(*builder);
+			}
+
+			tokens.clear();
+		};
+
+		try
+		{
+			size_t bytesLeft = limits.maxInputBytes;
+			while (status == ParseStatus::Complete && bytesLeft > 0
+				&& (is.read(chunk.data(), std::min(chunkSize, bytesLeft)) || is.gcount() > 0))
+			{
+				bytesLeft -= (size_t)is.gcount();
+				lexer.feed(std::string_view(chunk.data(), (size_t)is.gcount()), tokens);
+				buildTokens();
+			}
+
+			// If a limit is passed, the rest of the chunks read is lexed only to get the lexer
+			// ready for the next document.
+			lexer.finish(tokens);
+			buildTokens();
+
+			if (status == ParseStatus::Complete && bytesLeft == 0 && is.peek() != std::istream::traits_type::eof())
+			{
+				status = ParseStatus::InputTooLarge;
+			}
+		}
+		catch (...)
+		{
+			// Start the next document from scratch.
+			lexer = IncrementalLexer();
+			tokens.clear();
+			throw;
+		}
+
+		return HTMLDocument(&memory, options, std::move(root));
+	}
+}
@@ -0,0 +1,43 @@
+#include "IncrementalParser.h"
+
+#include <exception>
+
+namespace html_parser {
+	IncrementalParser::IncrementalParser(std::pmr::memory_resource* memory, const ParseOptions& options)
+		: document(memory, options), builder(*document.domRoot, options) {}
+
+	void IncrementalParser::buildTokens()
+	{
+		for (const Token& token : tokens)
+		{
+			builder.append(token);
+		}
+
+		tokens.clear();
+	}
+
+	void IncrementalParser::feed(std::string_view chunk)
+	{
+		if (finished)
+		{
+			throw std::logic_error("feed() called on a finished IncrementalParser");
+		}
+
+		lexer.feed(chunk, tokens);
+		buildTokens();
+	}
+
+	HTMLDocument IncrementalParser::finish()
+	{
+		if (finished)
+		{
+			throw std::logic_error("finish() called on a finished IncrementalParser");
+		}
+
+		lexer.finish(tokens);
+		buildTokens();
+
+		finished = true;
+		return std::move(document);
+	}
+}
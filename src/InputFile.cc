@@ -0,0 +1,196 @@
+#include "InputFile.h"
+
+#include <cerrno>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace html_parser {
+	static const std::string standardInput = "-";
+
+#ifdef _WIN32
+	static std::system_error lastError(const std::string& what)
+	{
+		return std::system_error((int)GetLastError(), std::system_category(), what);
+	}
+
+	InputFile::InputFile(const std::string& path)
+	{
+		if (path == standardInput)
+		{
+			file = GetStdHandle(STD_INPUT_HANDLE);
+		}
+		else
+		{
+			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+				OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				throw lastError("Failed to open " + path);
+			}
+
+			ownsFile = true;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &fileSize))
+		{
+			return;
+		}
+
+		size = (size_t)fileSize.QuadPart;
+		if (size == 0)
+		{
+			// A empty file can't be mapped. Some files (like those in /proc) report no size
+			// but do have contents, so read it.
+			return;
+		}
+
+		fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (fileMapping != nullptr)
+		{
+			mapping = (const char*)MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+		}
+
+		if (mapping == nullptr)
+		{
+			// Read it instead.
+			size = 0;
+			return;
+		}
+
+		mapped = true;
+	}
+
+	InputFile::~InputFile()
+	{
+		if (mapping != nullptr)
+		{
+			UnmapViewOfFile(mapping);
+		}
+
+		if (fileMapping != nullptr)
+		{
+			CloseHandle(fileMapping);
+		}
+
+		if (ownsFile)
+		{
+			CloseHandle(file);
+		}
+	}
+
+	size_t InputFile::read(char* buffer, size_t size)
+	{
+		DWORD bytesRead;
+		DWORD bytesToRead = size > MAXDWORD ? MAXDWORD : (DWORD)size;
+		if (!ReadFile(file, buffer, bytesToRead, &bytesRead, nullptr))
+		{
+			// The write end of a pipe closed.
+			if (GetLastError() == ERROR_BROKEN_PIPE)
+			{
+				return 0;
+			}
+
+			throw lastError("Failed to read the input file");
+		}
+
+		return bytesRead;
+	}
+#else
+	static std::system_error lastError(const std::string& what)
+	{
+		return std::system_error(errno, std::generic_category(), what);
+	}
+
+	InputFile::InputFile(const std::string& path)
+	{
+		if (path == standardInput)
+		{
+			fd = STDIN_FILENO;
+		}
+		else
+		{
+			do
+			{
+				fd = open(path.c_str(), O_RDONLY);
+			} while (fd == -1 && errno == EINTR);
+
+			if (fd == -1)
+			{
+				throw lastError("Failed to open " + path);
+			}
+
+			ownsFile = true;
+		}
+
+		struct stat status;
+		if (fstat(fd, &status) != 0 || !S_ISREG(status.st_mode))
+		{
+			return;
+		}
+
+		size = (size_t)status.st_size;
+		if (size == 0)
+		{
+			// A empty file can't be mapped. Some files (like those in /proc) report no size
+			// but do have contents, so read it.
+			return;
+		}
+
+		void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (address == MAP_FAILED)
+		{
+			// Read it instead.
+			size = 0;
+			return;
+		}
+
+		mapped = true;
+
+		// It's lexed from the start to the end, so read ahead aggressively.
+		madvise(address, size, MADV_SEQUENTIAL);
+		mapping = (const char*)address;
+	}
+
+	InputFile::~InputFile()
+	{
+		if (mapping != nullptr)
+		{
+			munmap((void*)mapping, size);
+		}
+
+		if (ownsFile)
+		{
+			close(fd);
+		}
+	}
+
+	size_t InputFile::read(char* buffer, size_t size)
+	{
+		for (;;)
+		{
+			ssize_t bytesRead = ::read(fd, buffer, size);
+			if (bytesRead >= 0)
+			{
+				return (size_t)bytesRead;
+			}
+
+			if (errno != EINTR)
+			{
+				throw lastError("Failed to read the input file");
+			}
+		}
+	}
+#endif
+}
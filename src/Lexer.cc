@@ -1,47 +1,853 @@
 #include "Lexer.h"
 
+#include <algorithm>
+#include <future>
 #include <iostream>
 #include <string>
 
+#include "Elements.h"
+
+#ifndef USE_REGEX_LEXER
+#include "Scanner.h"
+#endif
+
 namespace html_parser {
-	std::vector<Token> getTokens(const std::string& htmlContents)
+	// Because we assume that the HTML file is UTF-8 encoded, so if the HTML contents
+	// have UTF-8 BOM (Byte Order Mark), just ignore it.
+	static const std::string byteOrderMark = "\xEF\xBB\xBF";
+
+	static inline bool isAlpha(char ch)
 	{
-		static const regex reTagLike(
-			R"(<(?:(?:!--(?:[\S\s]*?)--)|(?:\/?[a-zA-Z][^>\s]*)\s*(?:[^>\s][^>\s=]*(?:\s*=\s*(?:(?:\"[\S\s]*?\")|(?:'[\S\s]*?')|(?:[^\s>]+)))?\s*)*?)>)");
+		return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+	}
+
+	// The raw text element opened by a tag-like token, or empty if it's not such a open tag.
+	static std::string_view getRawTextElement(const Token& token)
+	{
+		std::string_view tag = token.content;
+		if (token.type != Token::Type::TagLike || tag.length() < 2 || !isAlpha(tag[1]))
+		{
+			// Not a open tag.
+			return std::string_view();
+		}
+
+		size_t nameEnd = 2;
+		while (nameEnd < tag.length() && tag[nameEnd] != '>' && !isSpace(tag[nameEnd]))
+		{
+			nameEnd++;
+		}
+
+		std::string_view tagName = tag.substr(1, nameEnd - 1);
+		for (std::string_view element : rawTextElements)
+		{
+			if (equalsIgnoreCase(tagName, element))
+			{
+				return element;
+			}
+		}
+
+		return std::string_view();
+	}
+
+	// Returned by matchTag() and findRawTextEnd() if the token can't be decided until more
+	// contents appended.
+	static constexpr size_t incomplete = std::string_view::npos - 1;
+
+	TokenStream::TokenStream(std::string_view input, size_t searchStart, size_t pos, bool final, size_t lastTagClose)
+		: input(input), final(final), searchStart(searchStart), pos(pos), lastTagClose(lastTagClose) {}
+
+	TokenStream::TokenStream(std::string_view htmlContents)
+		: TokenStream(htmlContents, 0, 0, true, htmlContents.rfind('>'))
+	{
+		if (starts_with(htmlContents, byteOrderMark))
+		{
+			searchStart = pos = byteOrderMark.length();
+		}
+	}
+
+	TokenStream::TokenStream(std::string_view htmlContents, size_t start)
+		: TokenStream(htmlContents, start, start, true, htmlContents.rfind('>')) {}
+
+	// Whether a tag-like token may start at or after pos.
+	bool TokenStream::mayMatchFrom(size_t pos) const
+	{
+		return lastTagClose != std::string_view::npos && pos < lastTagClose;
+	}
+
+	// Find where the contents of the raw text element rawTextTag end, searching from pos: the
+	// '<' of its close tag, or the end of the input. The close tag is "</" and the tag name in
+	// any case, followed by a whitespace or the '>' -- as a tag-like token, whose name is
+	// matched by the DOM builder. Return incomplete if it can't be decided until more contents
+	// appended, with pos left where the search stopped.
+	size_t TokenStream::findRawTextEnd()
+	{
+		size_t length = input.length(), nameLength = rawTextTag.length();
+		for (; (pos = input.find('<', pos)) != std::string_view::npos; pos++)
+		{
+			size_t nameEnd = pos + 2 + nameLength;
+			if (nameEnd >= length)
+			{
+				// Too close to the end to be a close tag, and so is every '<' after.
+				if (!final)
+				{
+					return incomplete;
+				}
+
+				break;
+			}
+
+			if (input[pos + 1] != '/' || !equalsIgnoreCase(input.substr(pos + 2, nameLength), rawTextTag))
+			{
+				continue;
+			}
+
+			if (input[nameEnd] == '>' || (isSpace(input[nameEnd]) && mayMatchFrom(nameEnd)))
+			{
+				return pos;
+			}
+
+			if (isSpace(input[nameEnd]))
+			{
+				// No '>' to close the tag, nor any tag after.
+				if (!final)
+				{
+					return incomplete;
+				}
+
+				break;
+			}
+		}
+
+		pos = length;
+		return final ? length : incomplete;
+	}
+
+	// Lex the contents of the raw text element rawTextTag. Return false if they're empty,
+	// with rawTextTag cleared, or if they can't be decided until more contents appended.
+	bool TokenStream::lexRawText(Token& token)
+	{
+		size_t end = findRawTextEnd();
+		if (end == incomplete)
+		{
+			return false;
+		}
 
+		rawTextTag = std::string_view();
+
+		size_t textStart = searchStart;
+		searchStart = pos = end;
+		if (end == textStart)
+		{
+			return false;
+		}
+
+		token = Token(Token::Type::Text, input.substr(textStart, end - textStart));
+		return true;
+	}
+
+	std::vector<Token> getTokens(std::string_view htmlContents)
+	{
 		std::vector<Token> tokens;
 
-		// Because we assume that the HTML file is UTF-8 encoded, so if the HTML contents
-		// have UTF-8 BOM (Byte Order Mark), just ignore it.
-		static const std::string byteOrderMark = "\xEF\xBB\xBF";
-		bool hasBOM = starts_with(htmlContents, byteOrderMark);
+		for (const Token& token : TokenStream(htmlContents))
+		{
+			tokens.push_back(token);
+		}
+
+		return tokens;
+	}
+
+	// A document is only lexed in parallel with at least this many bytes for each thread.
+	static const size_t minimumSegmentSize = 256 * 1024;
 
-		std::string::const_iterator searchStart = hasBOM
-			? htmlContents.cbegin() + byteOrderMark.length()
-			: htmlContents.cbegin();
+	static inline size_t getTokenStart(std::string_view input, const Token& token)
+	{
+		return token.content.data() - input.data();
+	}
 
-		match_results match;
-		while (regex_search(searchStart, htmlContents.cend(), match, reTagLike))
+	static inline size_t getTokenEnd(std::string_view input, const Token& token)
+	{
+		return getTokenStart(input, token) + token.content.length();
+	}
+
+	// Lex from start, as if a token starts there, until a token starts at or after end.
+	static std::vector<Token> lexSegment(std::string_view input, size_t start, size_t end)
+	{
+		std::vector<Token> tokens;
+
+		TokenStream stream(input, start);
+		Token token(Token::Type::Text, std::string_view());
+		while (stream.next(token) && getTokenStart(input, token) < end)
 		{
-			searchStart = match.suffix().first;
+			tokens.push_back(token);
+		}
 
-			auto unmatched = match.prefix();
-			if (unmatched.length() > 0)
+		return tokens;
+	}
+
+	// Find the token starting at pos in the sorted tokens, or return tokens.end().
+	static std::vector<Token>::const_iterator findTokenAt(std::string_view input, const std::vector<Token>& tokens, size_t pos)
+	{
+		auto it = std::lower_bound(tokens.begin(), tokens.end(), pos, [&](const Token& token, size_t pos) {
+			return getTokenStart(input, token) < pos;
+		});
+
+		return it != tokens.end() && getTokenStart(input, *it) == pos ? it : tokens.end();
+	}
+
+	std::vector<Token> getTokensParallel(std::string_view htmlContents, unsigned threadCount)
+	{
+		size_t start = starts_with(htmlContents, byteOrderMark) ? byteOrderMark.length() : 0;
+		size_t length = htmlContents.length();
+
+		// Every segment but the first starts with a '<', likely to be a tag.
+		std::vector<size_t> segmentStarts = { start };
+		size_t segmentCount = std::min<size_t>(threadCount, (length - start) / minimumSegmentSize);
+		for (size_t i = 1; i < segmentCount; i++)
+		{
+			size_t segmentStart = htmlContents.find('<', start + (length - start) / segmentCount * i);
+			if (segmentStart == std::string_view::npos)
+			{
+				break;
+			}
+
+			if (segmentStart > segmentStarts.back())
 			{
-				// Some text found before a match.
-				tokens.emplace_back(Token::Type::Text, unmatched.str());
+				segmentStarts.push_back(segmentStart);
 			}
+		}
+
+		if (segmentStarts.size() == 1)
+		{
+			return getTokens(htmlContents);
+		}
 
-			auto matched = match[0];
-			tokens.emplace_back(Token::Type::TagLike, matched.str());
+		segmentStarts.push_back(length);
+		segmentCount = segmentStarts.size() - 1;
+
+		std::vector<std::future<std::vector<Token>>> futures;
+		for (size_t i = 1; i < segmentCount; i++)
+		{
+			futures.push_back(std::async(std::launch::async, lexSegment, htmlContents, segmentStarts[i], segmentStarts[i + 1]));
 		}
 
-		// Some contents unmatched in the end, add a text token.
-		if (searchStart != htmlContents.cend())
+		std::vector<std::vector<Token>> segments;
+		segments.push_back(lexSegment(htmlContents, segmentStarts[0], segmentStarts[1]));
+		for (std::future<std::vector<Token>>& future : futures)
 		{
-			tokens.emplace_back(Token::Type::Text, std::string(searchStart, htmlContents.cend()));
+			segments.push_back(future.get());
+		}
+
+		// Join the segments. Lexing is the same from where a token starts, in the same mode --
+		// in the contents of a raw text element right after its open tag, or not. So once the
+		// next token starts where one of a segment's does, with the token before in both
+		// opening the same raw text element (or none), the segment's tokens from there are the
+		// right ones. Otherwise lex on from there, until they agree again.
+		std::vector<Token> tokens;
+		size_t pos = start, segment = 0;
+		std::string_view rawTextTag;
+
+		auto findAgreeingToken = [&]() {
+			while (segment + 1 < segmentCount && segmentStarts[segment + 1] <= pos)
+			{
+				segment++;
+			}
+
+			const std::vector<Token>& segmentTokens = segments[segment];
+			auto it = findTokenAt(htmlContents, segmentTokens, pos);
+			if (it != segmentTokens.end()
+				&& rawTextTag != (it == segmentTokens.begin() ? std::string_view() : getRawTextElement(*std::prev(it))))
+			{
+				return segmentTokens.end();
+			}
+
+			return it;
+		};
+
+		while (pos < length)
+		{
+			auto it = findAgreeingToken();
+			if (it != segments[segment].end())
+			{
+				tokens.insert(tokens.end(), it, segments[segment].cend());
+				pos = getTokenEnd(htmlContents, tokens.back());
+				rawTextTag = getRawTextElement(tokens.back());
+				continue;
+			}
+
+			TokenStream stream(htmlContents, pos);
+			stream.rawTextTag = rawTextTag;
+
+			Token token(Token::Type::Text, std::string_view());
+			while (stream.next(token))
+			{
+				tokens.push_back(token);
+				pos = getTokenEnd(htmlContents, token);
+				rawTextTag = getRawTextElement(token);
+
+				if (findAgreeingToken() != segments[segment].end())
+				{
+					break;
+				}
+			}
+
+			// If the stream ends, the tokens lexed reach the end of the contents.
 		}
 
 		return tokens;
 	}
+
+#ifdef USE_REGEX_LEXER
+	bool TokenStream::next(Token& token)
+	{
+		static const regex reTagLike(
+			R"(<(?:(?:!--(?:[\S\s]*?)--)|(?:\/?[a-zA-Z][^>\s]*)\s*(?:[^>\s][^>\s=]*(?:\s*=\s*(?:(?:\"[\S\s]*?\")|(?:'[\S\s]*?')|(?:[^\s>]+)))?\s*)*?)>)");
+
+		if (pendingTag != std::string_view::npos)
+		{
+			token = Token(Token::Type::TagLike, input.substr(pendingTag, searchStart - pendingTag));
+			pendingTag = std::string_view::npos;
+			return true;
+		}
+
+		if (!rawTextTag.empty())
+		{
+			if (lexRawText(token))
+			{
+				return true;
+			}
+
+			if (!rawTextTag.empty())
+			{
+				// Where the raw text ends can't be decided yet.
+				return false;
+			}
+		}
+
+		if (searchStart == input.length())
+		{
+			return false;
+		}
+
+		const char* data = input.data();
+
+		cmatch_results match;
+		if (regex_search(data + searchStart, data + input.length(), match, reTagLike))
+		{
+			size_t textStart = searchStart;
+			size_t tagStart = match[0].first - data;
+			searchStart = pos = match[0].second - data;
+			rawTextTag = getRawTextElement(Token(Token::Type::TagLike, input.substr(tagStart, searchStart - tagStart)));
+
+			if (tagStart > textStart)
+			{
+				// Some text found before a match, the match is given next.
+				pendingTag = tagStart;
+				token = Token(Token::Type::Text, input.substr(textStart, tagStart - textStart));
+				return true;
+			}
+
+			token = Token(Token::Type::TagLike, input.substr(tagStart, searchStart - tagStart));
+			return true;
+		}
+
+		// Some contents unmatched in the end, give a text token.
+		token = Token(Token::Type::Text, input.substr(searchStart));
+		searchStart = input.length();
+		return true;
+	}
+
+	void IncrementalLexer::append(std::string_view chunk)
+	{
+		buffer.erase(0, searchStart);
+		searchStart = 0;
+
+		buffer.append(chunk);
+	}
+
+	// The regex can't tell whether a token is complete, so everything is lexed when finished.
+	void IncrementalLexer::feed(std::string_view chunk, std::vector<Token>& tokens)
+	{
+		(void)tokens;
+		append(chunk);
+	}
+
+	void IncrementalLexer::finish(std::vector<Token>& tokens)
+	{
+		append("");
+
+		for (const Token& token : TokenStream(buffer))
+		{
+			tokens.push_back(token);
+		}
+
+		searchStart = buffer.length();
+	}
+#else
+	// Find the first delimiter in text[from, to). Return npos if not found.
+	static inline size_t findDelimiter(std::string_view text, size_t from, size_t to, const DelimiterSet& delimiters)
+	{
+		const char* data = text.data();
+		const char* found = findDelimiter(data + from, data + to, delimiters);
+		return found == data + to ? std::string_view::npos : found - data;
+	}
+
+	// Bytes that end a run of a tag name or a unquoted attribute value.
+	static constexpr DelimiterSet tagNameDelimiters(">", true);
+
+	// Bytes that end a run of a attribute name.
+	static constexpr DelimiterSet attributeNameDelimiters(">=", true);
+
+	static constexpr DelimiterSet tagOpenDelimiters("<");
+
+	enum class TagState
+	{
+		TagName,
+		BeforeAttributeName,
+		AttributeName,
+		AfterAttributeName,
+		BeforeAttributeValue,
+		AttributeValueUnquoted
+	};
+
+	// Find the closing quote of a quoted attribute value, which must be before the last '>'.
+	// Return npos if not found. If the input is not final, a closing quote before the last
+	// '>' so far is still such a quote after more contents appended.
+	size_t TokenStream::findClosingQuote(char quote, size_t from)
+	{
+		// The latest search stopped at a quote, or at the last '>' if there was none before.
+		// If the last '>' is further now, the search is resumed from there.
+		Search& search = quote == '"' ? doubleQuote : singleQuote;
+		if (search.from > from || search.next < from)
+		{
+			search.from = search.next = from;
+		}
+
+		if (search.next < lastTagClose && input[search.next] != quote)
+		{
+			search.next = findDelimiter(input, search.next, lastTagClose, quote == '"' ? DelimiterSet("\"") : DelimiterSet("'"));
+			if (search.next == std::string_view::npos)
+			{
+				// No more usable quotes before the last '>'.
+				search.next = lastTagClose;
+			}
+		}
+
+		return search.next < lastTagClose ? search.next : std::string_view::npos;
+	}
+
+	size_t TokenStream::matchComment(size_t pos)
+	{
+		static const std::string end = "-->";
+
+		// The latest search stopped at a comment's end, or where one may start in the
+		// contents appended if there was none.
+		size_t from = pos + 4;
+		if (commentEnd.from > from || commentEnd.next < from)
+		{
+			commentEnd.from = commentEnd.next = from;
+		}
+
+		if (input.compare(commentEnd.next, end.length(), end) != 0)
+		{
+			size_t found = input.find(end, commentEnd.next);
+			if (found == std::string_view::npos)
+			{
+				commentEnd.next = std::max(commentEnd.next, input.length() - std::min(input.length(), end.length() - 1));
+				return final ? std::string_view::npos : incomplete;
+			}
+
+			commentEnd.next = found;
+		}
+
+		return commentEnd.next + end.length();
+	}
+
+	// Match a tag-like token starting with the '<' at pos. Return the position past its
+	// closing '>', npos if it's not a tag-like token, or incomplete.
+	//
+	// It's a hand-written equivalent of the regex lexer's pattern:
+	//
+	// <(?:(?:!--(?:[\S\s]*?)--)|(?:\/?[a-zA-Z][^>\s]*)\s*(?:[^>\s][^>\s=]*(?:\s*=\s*(?:(?:\"[\S\s]*?\")|(?:'[\S\s]*?')|(?:[^\s>]+)))?\s*)*?)>
+	//
+	// The backtracking of that pattern only ever matters in two places: a tag can't be
+	// matched without a '>' after it, and a quoted attribute value is only taken as quoted
+	// if its closing quote comes before the last '>' of the document (otherwise the regex
+	// falls back to matching it as an unquoted value). Knowing the position of the last '>'
+	// up front, every tag is matched by one forward pass over its bytes.
+	//
+	// All the searches for a closing quote or a comment's end are remembered, so no byte
+	// is scanned more than a constant number of times -- the whole lexing is linear. Runs of
+	// bytes that can't change the state are skipped with the SIMD scanner.
+	//
+	// If the input is not final, whatever depends on the contents after it is reported as
+	// incomplete instead of guessed.
+	size_t TokenStream::matchTag(size_t pos, TagParts* parts)
+	{
+		static const std::string_view commentStart = "!--";
+
+		size_t length = input.length();
+		size_t i = pos + 1;
+
+		size_t available = length - i;
+		if (!final && available < commentStart.length() && commentStart.substr(0, available) == input.substr(i))
+		{
+			// Could be the start of a comment or a tag.
+			return incomplete;
+		}
+
+		if (input.compare(i, commentStart.length(), commentStart) == 0)
+		{
+			return matchComment(pos);
+		}
+
+		if (i < length && input[i] == '/')
+		{
+			i++;
+		}
+
+		if (i < length && !isAlpha(input[i]))
+		{
+			return std::string_view::npos;
+		}
+
+		if (i >= length || !mayMatchFrom(i))
+		{
+			// Nothing can close the tag, yet.
+			return final ? std::string_view::npos : incomplete;
+		}
+
+		// To extract the parts: where the tag name or the attribute name being lexed starts,
+		// where the unquoted value being lexed starts, and the last '='.
+		size_t nameStart = i, valueStart = 0, equalsSign = 0;
+		std::string_view attributeName;
+
+		auto getName = [&]() {
+			return input.substr(nameStart, i - nameStart);
+		};
+
+		auto addAttribute = [&](std::string_view name, std::string_view value) {
+			if (parts != nullptr)
+			{
+				parts->attributes.push_back({ name, value });
+			}
+		};
+
+		if (parts != nullptr)
+		{
+			parts->attributes.clear();
+		}
+
+		// There is a '>' after, so the loop never runs out of input.
+		TagState state = TagState::TagName;
+		for (i++; ; i++)
+		{
+			// Skip the run of bytes that won't change the state.
+			if (state == TagState::TagName || state == TagState::AttributeValueUnquoted)
+			{
+				i = findDelimiter(input, i, lastTagClose + 1, tagNameDelimiters);
+			}
+			else if (state == TagState::AttributeName)
+			{
+				i = findDelimiter(input, i, lastTagClose + 1, attributeNameDelimiters);
+			}
+
+			char ch = input[i];
+			if (ch == '>')
+			{
+				if (parts == nullptr)
+				{
+					return i + 1;
+				}
+
+				switch (state)
+				{
+				case TagState::TagName:
+					parts->name = getName();
+					break;
+				case TagState::AttributeName:
+					addAttribute(getName(), std::string_view());
+					break;
+				case TagState::AfterAttributeName:
+					addAttribute(attributeName, std::string_view());
+					break;
+				case TagState::BeforeAttributeValue:
+					// The regex parseTagOpen() used to take a '=' without a value as the name of
+					// another attribute.
+					addAttribute(attributeName, std::string_view());
+					addAttribute(input.substr(equalsSign, 1), std::string_view());
+					break;
+				case TagState::AttributeValueUnquoted:
+					addAttribute(attributeName, input.substr(valueStart, i - valueStart));
+					break;
+				default:
+					break;
+				}
+
+				return i + 1;
+			}
+
+			switch (state)
+			{
+			case TagState::TagName:
+				if (isSpace(ch))
+				{
+					if (parts != nullptr)
+						parts->name = getName();
+					state = TagState::BeforeAttributeName;
+				}
+				break;
+			case TagState::BeforeAttributeName:
+				if (!isSpace(ch))
+				{
+					nameStart = i;
+					state = TagState::AttributeName;
+				}
+				break;
+			case TagState::AttributeName:
+				if (isSpace(ch))
+				{
+					attributeName = getName();
+					state = TagState::AfterAttributeName;
+				}
+				else if (ch == '=')
+				{
+					attributeName = getName();
+					equalsSign = i;
+					state = TagState::BeforeAttributeValue;
+				}
+				break;
+			case TagState::AfterAttributeName:
+				if (ch == '=')
+				{
+					equalsSign = i;
+					state = TagState::BeforeAttributeValue;
+				}
+				else if (!isSpace(ch))
+				{
+					addAttribute(attributeName, std::string_view());
+					nameStart = i;
+					state = TagState::AttributeName;
+				}
+				break;
+			case TagState::BeforeAttributeValue:
+				if (ch == '"' || ch == '\'')
+				{
+					size_t closingQuote = findClosingQuote(ch, i + 1);
+					if (closingQuote != std::string_view::npos)
+					{
+						addAttribute(attributeName, input.substr(i + 1, closingQuote - i - 1));
+						i = closingQuote;
+						state = TagState::BeforeAttributeName;
+					}
+					else if (!final)
+					{
+						return incomplete;
+					}
+					else
+					{
+						// Unmatched quote, it's just a part of a unquoted value.
+						valueStart = i;
+						state = TagState::AttributeValueUnquoted;
+					}
+				}
+				else if (!isSpace(ch))
+				{
+					valueStart = i;
+					state = TagState::AttributeValueUnquoted;
+				}
+				break;
+			case TagState::AttributeValueUnquoted:
+				if (isSpace(ch))
+				{
+					addAttribute(attributeName, input.substr(valueStart, i - valueStart));
+					state = TagState::BeforeAttributeName;
+				}
+				break;
+			}
+		}
+	}
+
+	// If the input is not final, stop before the first token which can't be decided until
+	// more contents appended -- searchStart is left at its start, and pos where the search
+	// for '<' stopped, to resume from later.
+	bool TokenStream::lex(Token& token, TagParts* parts)
+	{
+		if (pendingTag != std::string_view::npos)
+		{
+			token = Token(Token::Type::TagLike, input.substr(pendingTag, searchStart - pendingTag));
+			pendingTag = std::string_view::npos;
+			return true;
+		}
+
+		if (!rawTextTag.empty())
+		{
+			if (lexRawText(token))
+			{
+				return true;
+			}
+
+			if (!rawTextTag.empty())
+			{
+				// Where the raw text ends can't be decided yet.
+				return false;
+			}
+		}
+
+		for (;
+			(pos = findDelimiter(input, pos, input.length(), tagOpenDelimiters)) != std::string_view::npos
+			&& (!final || mayMatchFrom(pos));
+			)
+		{
+			size_t end = matchTag(pos, parts);
+			if (end == incomplete)
+			{
+				return false;
+			}
+
+			if (end == std::string_view::npos)
+			{
+				// Not a tag, the '<' is just a part of some text.
+				pos++;
+				continue;
+			}
+
+			size_t textStart = searchStart, tagStart = pos;
+			searchStart = pos = end;
+			rawTextTag = getRawTextElement(Token(Token::Type::TagLike, input.substr(tagStart, end - tagStart)));
+
+			if (tagStart > textStart)
+			{
+				// Some text found before a match, the match is given next.
+				pendingTag = tagStart;
+				token = Token(Token::Type::Text, input.substr(textStart, tagStart - textStart));
+				return true;
+			}
+
+			token = Token(Token::Type::TagLike, input.substr(tagStart, end - tagStart));
+			return true;
+		}
+
+		pos = input.length();
+		if (!final || searchStart == input.length())
+		{
+			// If not final, the text may continue in the contents appended.
+			return false;
+		}
+
+		// Some contents unmatched in the end, give a text token.
+		token = Token(Token::Type::Text, input.substr(searchStart));
+		searchStart = input.length();
+		return true;
+	}
+
+	bool TokenStream::next(Token& token)
+	{
+		return lex(token, nullptr);
+	}
+
+	bool TokenStream::next(Token& token, TagParts& parts)
+	{
+		return lex(token, &parts);
+	}
+
+	void IncrementalLexer::append(std::string_view chunk)
+	{
+		// The tokens lexed before are not used anymore.
+		size_t erased = searchStart;
+		buffer.erase(0, erased);
+		pos -= erased;
+		searchStart = 0;
+
+		// No search resumes in the contents erased.
+		for (TokenStream::Search* search : { &commentEnd, &doubleQuote, &singleQuote })
+		{
+			search->from = search->from > erased ? search->from - erased : 0;
+			search->next = search->next > erased ? search->next - erased : 0;
+		}
+
+		if (lastTagClose != std::string_view::npos)
+		{
+			lastTagClose = lastTagClose >= erased ? lastTagClose - erased : std::string_view::npos;
+		}
+
+		// Only the chunk is searched for a further '>'.
+		size_t tagClose = chunk.rfind('>');
+		if (tagClose != std::string_view::npos)
+		{
+			lastTagClose = buffer.length() + tagClose;
+		}
+
+		buffer.append(chunk);
+	}
+
+	bool IncrementalLexer::checkBOM(bool final)
+	{
+		if (checkedBOM)
+		{
+			return true;
+		}
+
+		if (!final && buffer.length() < byteOrderMark.length() && starts_with(byteOrderMark, buffer))
+		{
+			// Can't tell yet.
+			return false;
+		}
+
+		if (starts_with(buffer, byteOrderMark))
+		{
+			searchStart = pos = byteOrderMark.length();
+		}
+
+		checkedBOM = true;
+		return true;
+	}
+
+	// Lex the buffer from where the last lexing stopped, appending the tokens.
+	void IncrementalLexer::lex(bool final, std::vector<Token>& tokens)
+	{
+		TokenStream stream(buffer, searchStart, pos, final, lastTagClose);
+		stream.rawTextTag = rawTextTag;
+		stream.commentEnd = commentEnd;
+		stream.doubleQuote = doubleQuote;
+		stream.singleQuote = singleQuote;
+
+		Token token(Token::Type::Text, std::string_view());
+		while (stream.next(token))
+		{
+			tokens.push_back(token);
+		}
+
+		searchStart = stream.searchStart;
+		pos = stream.pos;
+		rawTextTag = stream.rawTextTag;
+		commentEnd = stream.commentEnd;
+		doubleQuote = stream.doubleQuote;
+		singleQuote = stream.singleQuote;
+	}
+
+	void IncrementalLexer::feed(std::string_view chunk, std::vector<Token>& tokens)
+	{
+		append(chunk);
+
+		if (checkBOM(false))
+		{
+			lex(false, tokens);
+		}
+	}
+
+	void IncrementalLexer::finish(std::vector<Token>& tokens)
+	{
+		append("");
+		checkBOM(true);
+
+		lex(true, tokens);
+
+		// Ready for another document.
+		rawTextTag = std::string_view();
+		checkedBOM = false;
+		lastTagClose = std::string_view::npos;
+		commentEnd = doubleQuote = singleQuote = TokenStream::Search();
+	}
+#endif
 }
@@ -0,0 +1,184 @@
+#include "Scanner.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCANNER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+// MSVC allows using any intrinsics without enabling them for the whole file.
+#define TARGET_SSE2
+#define TARGET_AVX2
+#else
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace html_parser {
+	using FindDelimiterFunction = const char* (*)(const char*, const char*, const DelimiterSet&);
+
+	static const char* findDelimiterScalar(const char* begin, const char* end, const DelimiterSet& delimiters)
+	{
+		for (; begin != end; begin++)
+		{
+			if (delimiters.contains(*begin))
+				return begin;
+		}
+
+		return end;
+	}
+
+#ifdef SCANNER_X86
+	static inline unsigned countTrailingZeros(unsigned mask)
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (unsigned)index;
+#else
+		return (unsigned)__builtin_ctz(mask);
+#endif
+	}
+
+	TARGET_SSE2 static const char* findDelimiterSSE2(const char* begin, const char* end, const DelimiterSet& delimiters)
+	{
+		const __m128i character0 = _mm_set1_epi8(delimiters.characters[0]),
+			character1 = _mm_set1_epi8(delimiters.characters[1]),
+			character2 = _mm_set1_epi8(delimiters.characters[2]),
+			character3 = _mm_set1_epi8(delimiters.characters[3]);
+
+		// Whitespaces are ' ' and the range ['\t', '\r'].
+		const __m128i space = _mm_set1_epi8(' '),
+			controlFirst = _mm_set1_epi8('\t'),
+			controlRange = _mm_set1_epi8('\r' - '\t'),
+			whitespaceMask = delimiters.whitespace ? _mm_set1_epi8(-1) : _mm_setzero_si128();
+
+		for (; end - begin >= 16; begin += 16)
+		{
+			__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+
+			__m128i hit = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(block, character0), _mm_cmpeq_epi8(block, character1)),
+				_mm_or_si128(_mm_cmpeq_epi8(block, character2), _mm_cmpeq_epi8(block, character3)));
+
+			__m128i control = _mm_sub_epi8(block, controlFirst);
+			__m128i whitespace = _mm_or_si128(
+				_mm_cmpeq_epi8(block, space),
+				_mm_cmpeq_epi8(_mm_min_epu8(control, controlRange), control));
+			hit = _mm_or_si128(hit, _mm_and_si128(whitespace, whitespaceMask));
+
+			unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+			if (mask != 0)
+				return begin + countTrailingZeros(mask);
+		}
+
+		return findDelimiterScalar(begin, end, delimiters);
+	}
+
+	TARGET_AVX2 static const char* findDelimiterAVX2(const char* begin, const char* end, const DelimiterSet& delimiters)
+	{
+		const __m256i character0 = _mm256_set1_epi8(delimiters.characters[0]),
+			character1 = _mm256_set1_epi8(delimiters.characters[1]),
+			character2 = _mm256_set1_epi8(delimiters.characters[2]),
+			character3 = _mm256_set1_epi8(delimiters.characters[3]);
+
+		const __m256i space = _mm256_set1_epi8(' '),
+			controlFirst = _mm256_set1_epi8('\t'),
+			controlRange = _mm256_set1_epi8('\r' - '\t'),
+			whitespaceMask = delimiters.whitespace ? _mm256_set1_epi8(-1) : _mm256_setzero_si256();
+
+		for (; end - begin >= 32; begin += 32)
+		{
+			__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+
+			__m256i hit = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(block, character0), _mm256_cmpeq_epi8(block, character1)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(block, character2), _mm256_cmpeq_epi8(block, character3)));
+
+			__m256i control = _mm256_sub_epi8(block, controlFirst);
+			__m256i whitespace = _mm256_or_si256(
+				_mm256_cmpeq_epi8(block, space),
+				_mm256_cmpeq_epi8(_mm256_min_epu8(control, controlRange), control));
+			hit = _mm256_or_si256(hit, _mm256_and_si256(whitespace, whitespaceMask));
+
+			unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+			if (mask != 0)
+				return begin + countTrailingZeros(mask);
+		}
+
+		// Less than 32 bytes left.
+		return findDelimiterSSE2(begin, end, delimiters);
+	}
+
+	static bool cpuSupportsSSE2()
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2");
+#endif
+	}
+
+	static bool cpuSupportsAVX2()
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// The OS must also save the YMM registers on context switches.
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0,
+			avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	struct ScannerImplementation
+	{
+		FindDelimiterFunction function;
+		const char* name;
+	};
+
+	static ScannerImplementation selectImplementation()
+	{
+#ifdef SCANNER_X86
+		if (cpuSupportsAVX2())
+			return { findDelimiterAVX2, "avx2" };
+		if (cpuSupportsSSE2())
+			return { findDelimiterSSE2, "sse2" };
+#endif
+		return { findDelimiterScalar, "scalar" };
+	}
+
+	static const ScannerImplementation& getImplementation()
+	{
+		static const ScannerImplementation implementation = selectImplementation();
+		return implementation;
+	}
+
+	const char* findDelimiter(const char* begin, const char* end, const DelimiterSet& delimiters)
+	{
+		return getImplementation().function(begin, end, delimiters);
+	}
+
+	const char* getScannerImplementation()
+	{
+		return getImplementation().name;
+	}
+}
@@ -9,16 +9,22 @@
 #define regex boost::regex
 #define regex_search boost::regex_search
 #define match_results boost::match_results<std::string::const_iterator>
+#define cmatch_results boost::cmatch
 #else
 #include <regex>
 #include <algorithm>
 #define regex std::regex
 #define regex_search std::regex_search
 #define match_results std::smatch
+#define cmatch_results std::cmatch
 #endif
 
+#include <algorithm>
+#include <string>
+#include <string_view>
+
 namespace html_parser {
-    inline std::string to_lower(const std::string& text)
+    inline std::string to_lower(std::string_view text)
     {
         std::string clonedText(text);
 #ifdef USE_BOOST
@@ -29,7 +35,7 @@ namespace html_parser {
         return clonedText;
     }
 
-    inline bool starts_with(const std::string& text, const std::string& prefix)
+    inline bool starts_with(std::string_view text, std::string_view prefix)
     {
 #ifdef USE_BOOST
         return boost::starts_with(text, prefix);
@@ -38,7 +44,7 @@ namespace html_parser {
 #endif
     }
 
-    inline bool ends_with(const std::string& text, const std::string& suffix)
+    inline bool ends_with(std::string_view text, std::string_view suffix)
     {
 #ifdef USE_BOOST
         return boost::ends_with(text, suffix);
@@ -47,16 +53,32 @@ namespace html_parser {
 #endif
     }
 
-    static inline std::string trim(const std::string& text)
+    // Same characters as \s in the regexes.
+    inline bool isSpace(char ch)
     {
-        std::string clonedText(text);
-#ifdef USE_BOOST
-        boost::trim_left(clonedText);
-#else
-        clonedText.erase(clonedText.begin(), std::find_if(clonedText.begin(), clonedText.end(), [](unsigned char ch)
-            { return !std::isspace(ch); }));
-#endif
-        return clonedText;
+        return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || ch == '\f' || ch == '\r';
+    }
+
+    // Lower a ASCII letter, leaving other characters as they are, whatever the locale.
+    inline char toLowerAscii(char ch)
+    {
+        return ch >= 'A' && ch <= 'Z' ? ch - 'A' + 'a' : ch;
+    }
+
+    // Whether text equals lowerText, ignoring the case of text.
+    inline bool equalsIgnoreCase(std::string_view text, std::string_view lowerText)
+    {
+        return text.length() == lowerText.length() && std::equal(text.begin(), text.end(), lowerText.begin(), [](char ch, char lowerCh) {
+            return toLowerAscii(ch) == lowerCh;
+        });
+    }
+
+    // Only trims the left side, returns a view into the text.
+    static inline std::string_view trim(std::string_view text)
+    {
+        std::string_view::const_iterator begin = std::find_if(text.begin(), text.end(), [](unsigned char ch)
+            { return !std::isspace(ch); });
+        return text.substr(begin - text.begin());
     }
 }
 
@@ -0,0 +1,366 @@
+// Checks that the tags are parsed the same as the regexes DOMBuilder used before, on every
+// way a tree is built. Built with USE_REGEX_LEXER too, where the tags come from the regex
+// lexer without their parts.
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "macros.h"
+
+#include "html-parser/Atoms.h"
+#include "html-parser/DOMBuilder.h"
+#include "html-parser/Lexer.h"
+
+using namespace html_parser;
+
+static const std::string_view testCases[] = {
+	// Quoted '>' in values.
+	"<a href=\"x>y\" title='1>2'>link</a>",
+	"<div data-x=\"a > b\" data-y='<p>'>text</div>",
+
+	// Unquoted values.
+	"<input type=text value=a/b disabled>",
+	"<a href=http://example.com/?q=1&r=2 target=_blank>x</a>",
+
+	// Uppercase names.
+	"<DIV CLASS=\"A b\" ID=Main Data-X=1><SPAN>x</SPAN></DIV>",
+	"<Div><P>x</p></DIV>",
+	"<unknown-tag a=1><Unknown-Tag>x</UNKNOWN-TAG></unknown-tag>",
+
+	// Self-closing tags.
+	"<br/><img src=\"a.png\"/><div/>text</div>",
+	"<img src=a.png />",
+	"<custom-element attr=1 />x",
+
+	// Valueless and repeated attributes.
+	"<input checked disabled=\"\" checked=no>",
+	"<p class=\"b a b\" class=c id=x id=\"y z\">x</p>",
+	"<p class=\"\" id=\" \">x</p>",
+
+	// Malformed attributes.
+	"<div =x a==b c= d e =\"f\" g='h' i=\"j>text</div>",
+	"<div a=\"unclosed>x</div>y\">z</div>",
+	"<p a='x\"y' b=\"x'y\" c=\"\"\"\">x</p>",
+	"<div\tid=\"t\"\nclass='n'\r\ndata-a = b>x</div>",
+	"<p a= b=>x</p><p a=>y</p>",
+
+	// Stray '<'.
+	"a < b <c d <3 </ e><p>x<</p>",
+	"<p>1 < 2 and 3 > 2</p><>< /p>",
+	"<div>x <",
+
+	// Close tags.
+	"<div><span>x</div></span></div>",
+	"<div><b>x</B ><i>y</i\n></div >",
+	"<script>if (a < b) document.write('<div class=\"x\">')</SCRIPT ><div>ok</div>",
+	"<!-- <a href=x> --><a HREF = 'y'>z</a><!---->",
+};
+
+// What the regexes give for a element: its lowered name, and its attributes as the tree
+// keeps them.
+struct Element
+{
+	std::string description;
+	int parent;
+};
+
+static std::string describe(std::string_view tagName, const std::vector<std::pair<std::string, std::string>>& attributes,
+	const std::vector<std::string>& classList, const std::vector<std::string>& idList)
+{
+	std::string description(tagName);
+	for (const auto& [name, value] : attributes)
+	{
+		description += " " + name + "=[" + value + "]";
+	}
+
+	auto describeList = [&](const char* name, const std::vector<std::string>& list) {
+		description += std::string(" ") + name + "{";
+		for (const std::string& item : list)
+		{
+			description += "[" + item + "]";
+		}
+		description += "}";
+	};
+
+	describeList("class", classList);
+	describeList("id", idList);
+	return description;
+}
+
+// Split a class or id attribute as the tree does: by single spaces, sorted without duplicates.
+static std::vector<std::string> splitList(const std::string& value)
+{
+	std::vector<std::string> list;
+	size_t start = 0;
+	for (size_t end; (end = value.find(' ', start)) != std::string::npos; start = end + 1)
+	{
+		list.push_back(value.substr(start, end - start));
+	}
+	list.push_back(value.substr(start));
+
+	std::sort(list.begin(), list.end());
+	list.erase(std::unique(list.begin(), list.end()), list.end());
+	return list;
+}
+
+// The open tag parsing removed from DOMBuilder.
+static std::string describeTagOpen(std::string_view token)
+{
+	static const regex reTag("^<(\\S+)\\s*([\\S\\s]*)>$");
+	static const regex reAttribute(
+		"([^>\\s][^>\\s=]*)(?:\\s*=\\s*(?:(?:\"([\\S\\s]*?)\")|(?:'([\\S\\s]*?)')|([^\\s>]+)))?\\s*");
+
+	cmatch_results tagMatch;
+	if (!regex_search(token.data(), token.data() + token.length(), tagMatch, reTag))
+	{
+		return "(no match)";
+	}
+
+	std::vector<std::pair<std::string, std::string>> attributes;
+	std::optional<std::string> classValue, idValue;
+
+	cmatch_results match;
+	const char* searchStart = tagMatch[2].first;
+	const char* attributesEnd = tagMatch[2].second;
+	while (regex_search(searchStart, attributesEnd, match, reAttribute))
+	{
+		std::string name = to_lower(std::string(match[1].first, match[1].second)), value;
+		searchStart = match.suffix().first;
+
+		// A self-closing tag's close sign '/' is parsed to a attribute name.
+		if (name == "/")
+		{
+			continue;
+		}
+
+		for (int i = 2; i <= 4; i++)
+		{
+			if (match[i].length() > 0)
+			{
+				value = match[i].str();
+				break;
+			}
+		}
+
+		if (name == "class")
+		{
+			classValue = value;
+		}
+		else if (name == "id")
+		{
+			idValue = value;
+		}
+		else
+		{
+			auto it = std::find_if(attributes.begin(), attributes.end(), [&](const auto& attribute) {
+				return attribute.first == name;
+			});
+
+			if (it != attributes.end())
+			{
+				it->second = value;
+			}
+			else
+			{
+				attributes.emplace_back(name, value);
+			}
+		}
+	}
+
+	return describe(to_lower(std::string(tagMatch[1].first, tagMatch[1].second)), attributes,
+		classValue ? splitList(*classValue) : std::vector<std::string>(),
+		idValue ? splitList(*idValue) : std::vector<std::string>());
+}
+
+// The close tag parsing removed from DOMBuilder.
+static std::string parseTagClose(std::string_view token)
+{
+	static const regex reTagName("</(.+?)[\\s>]");
+
+	cmatch_results match;
+	if (!regex_search(token.data(), token.data() + token.length(), match, reTagName))
+	{
+		return "(no match)";
+	}
+
+	return to_lower(match[1].str());
+}
+
+// The elements of a document in order, built from its tokens by the rules of DOMBuilder,
+// with the tags parsed by the regexes.
+static std::vector<Element> getExpectedElements(std::string_view html)
+{
+	static const std::string_view commentStart = "<!--", commentEnd = "-->";
+
+	std::vector<Element> elements;
+
+	// The index and the name of each open element.
+	std::vector<std::pair<int, std::string>> openElements;
+
+	for (const Token& token : getTokens(html))
+	{
+		if (token.type != Token::Type::TagLike)
+		{
+			continue;
+		}
+
+		std::string_view tag = token.content;
+		if (!openElements.empty() && isElementOfKind(findAtom(openElements.back().second), RawTextElement))
+		{
+			// Only its close tag ends a raw text element.
+			if (starts_with(tag, "</") && parseTagClose(tag) == openElements.back().second)
+			{
+				openElements.pop_back();
+			}
+		}
+		else if (starts_with(tag, commentStart) && ends_with(tag, commentEnd))
+		{
+			// Comments don't change the elements.
+			continue;
+		}
+		else if (starts_with(tag, "</"))
+		{
+			// A close tag closes the innermost element with its name, if any.
+			std::string tagName = parseTagClose(tag);
+			auto it = std::find_if(openElements.rbegin(), openElements.rend(), [&](const auto& element) {
+				return element.second == tagName;
+			});
+
+			if (!isElementOfKind(findAtom(tagName), EmptyElement) && it != openElements.rend())
+			{
+				openElements.erase(std::prev(it.base()), openElements.end());
+			}
+		}
+		else
+		{
+			std::string description = describeTagOpen(tag);
+			std::string tagName = description.substr(0, description.find(' '));
+
+			elements.push_back(Element{ description, openElements.empty() ? -1 : openElements.back().first });
+			if (!isElementOfKind(findAtom(tagName), EmptyElement))
+			{
+				openElements.emplace_back((int)elements.size() - 1, tagName);
+			}
+		}
+	}
+
+	return elements;
+}
+
+// The elements of a tree in order.
+static std::vector<Element> getElements(const DOM::RootNode& root)
+{
+	std::vector<Element> elements;
+	std::unordered_map<const DOM::Node*, int> indices;
+
+	DOM::forEachInSubtree(&root, [&](DOM::Node* node, size_t) {
+		if (node->type != DOM::Node::Type::Element)
+		{
+			return true;
+		}
+
+		auto* element = static_cast<DOM::ElementNode*>(node);
+		std::vector<std::pair<std::string, std::string>> attributes;
+		for (const DOM::Attribute& attribute : element->getAttributes())
+		{
+			attributes.emplace_back(attribute.name, attribute.value);
+		}
+
+		auto toStrings = [](const std::pmr::vector<std::string_view>& list) {
+			return std::vector<std::string>(list.begin(), list.end());
+		};
+
+		auto parent = indices.find(element->parentNode);
+		elements.push_back(Element{
+			describe(element->tagName, attributes, toStrings(element->getClassList()), toStrings(element->getIdList())),
+			parent != indices.end() ? parent->second : -1 });
+		indices[element] = (int)elements.size() - 1;
+		return true;
+	});
+
+	return elements;
+}
+
+static std::shared_ptr<DOM::RootNode> buildFromChunks(std::string_view html)
+{
+	// A byte at a time, so every tag is lexed across chunks.
+	auto root = std::make_shared<DOM::RootNode>();
+	DOMBuilder builder(*root);
+	IncrementalLexer lexer;
+	std::vector<Token> tokens;
+	for (size_t i = 0; i <= html.length(); i++)
+	{
+		if (i < html.length())
+		{
+			lexer.feed(html.substr(i, 1), tokens);
+		}
+		else
+		{
+			lexer.finish(tokens);
+		}
+
+		for (const Token& token : tokens)
+		{
+			builder.append(token);
+		}
+
+		tokens.clear();
+	}
+
+	return root;
+}
+
+int main()
+{
+	// The lexer extracts the tags' parts while lexing them, except the regex lexer. A vector
+	// of tokens or a token at a time are built by parsing the tags, so are lazy attributes.
+	std::pair<const char*, std::shared_ptr<DOM::RootNode> (*)(std::string_view)> builds[] = {
+		{ "stream", [](std::string_view html) { return buildDOM(TokenStream(html)); } },
+		{ "tokens", [](std::string_view html) { return buildDOM(getTokens(html)); } },
+		{ "chunks", buildFromChunks },
+		{ "lazy", [](std::string_view html) {
+			ParseOptions options;
+			options.lazyAttributes = true;
+			return buildDOM(TokenStream(html), std::pmr::get_default_resource(), options);
+		} },
+	};
+
+	size_t failures = 0;
+	for (std::string_view html : testCases)
+	{
+		std::vector<Element> expected = getExpectedElements(html);
+		for (const auto& [buildName, build] : builds)
+		{
+			std::vector<Element> elements = getElements(*build(html));
+
+			bool same = elements.size() == expected.size();
+			for (size_t i = 0; same && i < elements.size(); i++)
+			{
+				same = elements[i].description == expected[i].description && elements[i].parent == expected[i].parent;
+			}
+
+			if (!same)
+			{
+				failures++;
+				std::cout << "FAILED (" << buildName << "): " << html << std::endl;
+				for (const Element& element : expected)
+				{
+					std::cout << "  expected " << element.parent << " " << element.description << std::endl;
+				}
+				for (const Element& element : elements)
+				{
+					std::cout << "  got      " << element.parent << " " << element.description << std::endl;
+				}
+			}
+		}
+	}
+
+	std::cout << std::size(testCases) << " cases, " << failures << " failed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -1,4 +1,5 @@
 option("boost", {showmenu = true,  default = true})
+option("regex_lexer", {showmenu = true,  default = false})
 
 if has_config("boost") then
     add_requires("boost")
@@ -15,7 +16,32 @@ target("html-parser")
     add_includedirs("include", {public = true})
     add_includedirs("include/html-parser", {public = false})
 
+    if is_plat("linux", "bsd") then
+        add_syslinks("pthread", {public = true})
+    end
+
+    if has_config("boost") then
+        add_packages("boost")
+        add_defines("USE_BOOST")
+    end
+
+    if has_config("regex_lexer") then
+        add_defines("USE_REGEX_LEXER")
+    end
+
+-- Run with and without --regex_lexer=y: the tags must be parsed the same either way.
+target("tag-parsing-test")
+    set_kind("binary")
+    set_default(false)
+    set_languages("cxx17")
+
+    add_files("tests/TagParsingTest.cc")
+    add_deps("html-parser")
+    add_includedirs("include/html-parser", "src")
+
     if has_config("boost") then
         add_packages("boost")
         add_defines("USE_BOOST")
-    end
\ No newline at end of file
+    end
+
+    add_tests("default")